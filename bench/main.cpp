@@ -0,0 +1,464 @@
+#include "file_parser.hpp"
+#include "interpolant.hpp"
+#include "interpolation_calc.hpp"
+#include "node_set.hpp"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char *kUsage =
+    R"(usage: interp_bench [options]
+
+Measures building and evaluating the interpolants of every method, parsing
+node files and generating LaTeX, and prints the results as JSON.
+
+options:
+  -o, --output FILE     write the JSON to FILE instead of standard output
+  -f, --filter TEXT     run only benchmarks whose id contains TEXT, e.g.
+                        "build/stirling" or "/1024/"
+  -q, --quick           smaller inputs and shorter timings, for smoke tests
+  -t, --min-time SEC    time spent on each benchmark (default: 0.2)
+      --max-global N    largest node count for one global polynomial
+                        (default: 4096); larger sets are only run windowed
+      --max-latex N     largest node count for to_latex() (default: 1024)
+      --window N        window size of the windowed runs (default: 8);
+                        Stirling runs one below an even N, Bessel one
+                        above an odd N
+  -h, --help            show this help
+)";
+
+struct Options {
+  std::string output;
+  std::string filter;
+  bool quick = false;
+  double min_time = 0.2;
+  std::size_t max_global = 4096;
+  std::size_t max_latex = 1024;
+  int window = 8;
+};
+
+/// Node counts every method is benchmarked with.
+static const std::size_t kNodeCounts[] = {4,    16,    64,    256,
+                                          1024, 4096, 16384, 100000};
+
+/// Query points per batch in the evaluation benchmarks.
+constexpr std::size_t kQueries = 4096;
+
+/// Timed samples per benchmark; the median is reported.
+constexpr int kSamples = 5;
+
+static const std::pair<IntepolationCalculator::InterpolationMethod,
+                       const char *>
+    kMethods[] = {{IntepolationCalculator::Lagrange, "lagrange"},
+                  {IntepolationCalculator::NewtonSeparated, "newton"},
+                  {IntepolationCalculator::NewtonFinite, "newton-finite"},
+                  {IntepolationCalculator::Stirling, "stirling"},
+                  {IntepolationCalculator::Bessel, "bessel"}};
+
+/// Keeps the compiler from discarding benchmarked results.
+static volatile double sink;
+
+/**
+ * @brief Parses a non-negative number given to an option.
+ * @return False if value is missing or not a number.
+ */
+template <class T> static bool parse_number(const char *value, T &number) {
+  if (value == nullptr) {
+    return false;
+  }
+  const char *end = value + std::strlen(value);
+  return std::from_chars(value, end, number).ptr == end && number >= 0;
+}
+
+/**
+ * @brief Parses the command line.
+ * @return False after printing an error or the help text; exit_code is set.
+ */
+static bool parse_options(int argc, char *argv[], Options &options,
+                          int &exit_code) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto value = [&]() -> const char * {
+      return i + 1 < argc ? argv[++i] : nullptr;
+    };
+    bool ok = true;
+    if (arg == "-h" || arg == "--help") {
+      std::fputs(kUsage, stdout);
+      exit_code = 0;
+      return false;
+    } else if (arg == "-o" || arg == "--output") {
+      const char *path = value();
+      options.output = path ? path : "";
+    } else if (arg == "-f" || arg == "--filter") {
+      const char *text = value();
+      options.filter = text ? text : "";
+    } else if (arg == "-q" || arg == "--quick") {
+      options.quick = true;
+    } else if (arg == "-t" || arg == "--min-time") {
+      ok = parse_number(value(), options.min_time);
+    } else if (arg == "--max-global") {
+      ok = parse_number(value(), options.max_global);
+    } else if (arg == "--max-latex") {
+      ok = parse_number(value(), options.max_latex);
+    } else if (arg == "--window") {
+      ok = parse_number(value(), options.window) && options.window > 0 &&
+           options.window <= WindowedInterpolant::kMaxWindow;
+    } else {
+      std::fprintf(stderr, "interp_bench: unknown option '%s'\n%s",
+                   arg.c_str(), kUsage);
+      exit_code = 2;
+      return false;
+    }
+    if (!ok) {
+      std::fprintf(stderr, "interp_bench: invalid value for %s\n",
+                   arg.c_str());
+      exit_code = 2;
+      return false;
+    }
+  }
+  if (options.quick) {
+    options.min_time = std::min(options.min_time, 0.02);
+    options.max_global = std::min<std::size_t>(options.max_global, 1024);
+    options.max_latex = std::min<std::size_t>(options.max_latex, 256);
+  }
+  return true;
+}
+
+/**
+ * @brief Median and minimum time of one operation.
+ */
+struct Timing {
+  double median_ns = 0;
+  double min_ns = 0;
+  std::size_t iterations = 0; ///< Operations per sample.
+  int samples = 0;
+};
+
+/**
+ * @brief Times op(), repeated so that all samples together take about
+ * min_time seconds.
+ *
+ * A first untimed call warms caches and calibrates the repetition count; an
+ * operation slower than min_time is timed once more and not repeated.
+ */
+template <class Op> static Timing measure(Op op, double min_time) {
+  using Clock = std::chrono::steady_clock;
+  auto seconds = [](Clock::duration d) {
+    return std::chrono::duration<double>(d).count();
+  };
+  Clock::time_point start = Clock::now();
+  op();
+  double first = seconds(Clock::now() - start);
+
+  Timing timing;
+  timing.samples = first >= min_time ? 1 : kSamples;
+  double per_sample = min_time / timing.samples;
+  timing.iterations = static_cast<std::size_t>(
+      std::clamp(per_sample / std::max(first, 1e-9), 1.0, 1e9));
+  std::vector<double> ns(timing.samples);
+  for (auto &sample : ns) {
+    start = Clock::now();
+    for (std::size_t i = 0; i < timing.iterations; i++) {
+      op();
+    }
+    sample = seconds(Clock::now() - start) * 1e9 / timing.iterations;
+  }
+  std::sort(ns.begin(), ns.end());
+  timing.median_ns = ns[ns.size() / 2];
+  timing.min_ns = ns.front();
+  return timing;
+}
+
+/**
+ * @brief Appends the shortest representation of value that reads back
+ * exactly, or null for a value JSON cannot hold.
+ */
+static void append_number(std::string &out, double value) {
+  if (!std::isfinite(value)) {
+    out += "null";
+    return;
+  }
+  char buffer[32];
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  out.append(buffer, result.ptr);
+}
+
+/**
+ * @brief Collects benchmark results as JSON objects.
+ */
+class Report {
+public:
+  explicit Report(const Options &options) : options(options) {}
+
+  /**
+   * @brief Id of a benchmark, "name/method/nodes/window".
+   */
+  static std::string id(const std::string &name, const std::string &method,
+                        std::size_t nodes, int window) {
+    return name + "/" + method + "/" + std::to_string(nodes) + "/" +
+           std::to_string(window);
+  }
+
+  /**
+   * @brief Tells whether a benchmark id passes the --filter option.
+   */
+  bool selected(const std::string &id) const {
+    return id.find(options.filter) != std::string::npos;
+  }
+
+  /**
+   * @brief Runs and records one benchmark.
+   * @param name Benchmark name.
+   * @param method Method name, or empty.
+   * @param nodes Node count.
+   * @param window Window size, 0 for global.
+   * @param items Work items per operation, e.g. queries or bytes.
+   * @param unit Name of the items.
+   * @param op The operation.
+   */
+  template <class Op>
+  void run(const std::string &name, const std::string &method,
+           std::size_t nodes, int window, std::size_t items,
+           const char *unit, Op op) {
+    std::string id = Report::id(name, method, nodes, window);
+    if (!selected(id)) {
+      return;
+    }
+    std::fprintf(stderr, "interp_bench: %s\n", id.c_str());
+    Timing timing = measure(op, options.min_time);
+
+    std::string &out = results.emplace_back();
+    out += "{\"id\": \"" + id + "\", \"name\": \"" + name +
+           "\", \"method\": \"" + method + "\", \"nodes\": ";
+    out += std::to_string(nodes) + ", \"window\": " + std::to_string(window);
+    out += ", \"median_ns\": ";
+    append_number(out, timing.median_ns);
+    out += ", \"min_ns\": ";
+    append_number(out, timing.min_ns);
+    out += ", \"iterations\": " + std::to_string(timing.iterations) +
+           ", \"samples\": " + std::to_string(timing.samples) +
+           ", \"items\": " + std::to_string(items) + ", \"unit\": \"" + unit +
+           "\", \"items_per_second\": ";
+    append_number(out, items * 1e9 / timing.median_ns);
+    out += "}";
+  }
+
+  /**
+   * @brief The whole report.
+   */
+  std::string json() const {
+    std::string out = "{\n  \"suite\": \"interp_bench\",\n  \"version\": 1,\n";
+    out += "  \"config\": {\"quick\": ";
+    out += options.quick ? "true" : "false";
+    out += ", \"min_time\": ";
+    append_number(out, options.min_time);
+    out += ", \"max_global\": " + std::to_string(options.max_global) +
+           ", \"max_latex\": " + std::to_string(options.max_latex) +
+           ", \"window\": " + std::to_string(options.window) +
+           ", \"queries\": " + std::to_string(kQueries) +
+           ", \"hardware_threads\": " +
+           std::to_string(std::thread::hardware_concurrency()) +
+           ", \"optimized\": ";
+#ifdef __OPTIMIZE__
+    out += "true";
+#else
+    out += "false";
+#endif
+    out += "},\n  \"results\": [";
+    for (std::size_t i = 0; i < results.size(); i++) {
+      out += i == 0 ? "\n    " : ",\n    ";
+      out += results[i];
+    }
+    out += "\n  ]\n}\n";
+    return out;
+  }
+
+private:
+  const Options &options;
+  std::vector<std::string> results;
+};
+
+/**
+ * @brief Equally spaced nodes of sin on [0, 1]; every method accepts them.
+ */
+static void make_nodes(std::size_t n, std::vector<double> &x,
+                       std::vector<double> &y) {
+  x.resize(n);
+  y.resize(n);
+  double h = 1.0 / static_cast<double>(n - 1);
+  for (std::size_t i = 0; i < n; i++) {
+    x[i] = static_cast<double>(i) * h;
+    y[i] = std::sin(3 * x[i]);
+  }
+}
+
+/**
+ * @brief The window nearest to size that method accepts: Stirling needs an
+ * odd one and Bessel an even one.
+ */
+static int method_window(IntepolationCalculator::InterpolationMethod method,
+                         int size) {
+  if (size > 0 && method == IntepolationCalculator::Stirling &&
+      size % 2 == 0) {
+    return size - 1;
+  }
+  if (method == IntepolationCalculator::Bessel && size % 2 != 0) {
+    return size + 1;
+  }
+  return size;
+}
+
+/**
+ * @brief Benchmarks building and evaluating every method on n nodes.
+ */
+static void bench_methods(Report &report, const Options &options,
+                          std::size_t n) {
+  std::vector<double> x, y;
+  make_nodes(n, x, y);
+  std::mt19937_64 random(n);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  std::vector<double> queries(kQueries), values(kQueries);
+  for (auto &q : queries) {
+    q = uniform(random);
+  }
+
+  for (int size : {0, options.window}) {
+    for (auto [method, name] : kMethods) {
+      int window = method_window(method, size);
+      if (window == 0 ? n > options.max_global
+                      : n <= static_cast<std::size_t>(window)) {
+        continue;
+      }
+      // A fresh NodeSet per build, so nothing comes from its caches; the
+      // nodes are viewed, not copied, and the hash is not recomputed.
+      auto fresh = [&] {
+        return std::make_shared<const NodeSet>(ValueSpan(x), ValueSpan(y),
+                                               nullptr, n);
+      };
+      report.run("build", name, n, window, n, "nodes", [&] {
+        IntepolationCalculator calculator(method, fresh(), window);
+        sink = evaluate(*calculator.get_interpolant(), 0.5);
+      });
+
+      IntepolationCalculator calculator(method, fresh(), window);
+      const Interpolant &interpolant = *calculator.get_interpolant();
+      report.run("evaluate", name, n, window, kQueries, "queries", [&] {
+        double sum = 0;
+        for (double q : queries) {
+          sum += evaluate(interpolant, q);
+        }
+        sink = sum;
+      });
+      report.run("evaluate_batch", name, n, window, kQueries, "queries", [&] {
+        calculator.interpolate_many(queries.data(), kQueries, values.data());
+        sink = values[0];
+      });
+      if (window == 0 && n <= options.max_latex &&
+          method != IntepolationCalculator::Stirling &&
+          method != IntepolationCalculator::Bessel) {
+        report.run("to_latex", name, n, window, n, "nodes", [&] {
+          sink = static_cast<double>(calculator.to_latex().size());
+        });
+      }
+    }
+  }
+}
+
+/**
+ * @brief Benchmarks parse_file() on a generated text node file.
+ * @return False if the file could not be written.
+ */
+static bool bench_parser(Report &report, const Options &options) {
+  std::size_t n = options.quick ? 100000 : 1000000;
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<unsigned> thread_counts = {1};
+  if (threads > 1) {
+    thread_counts.push_back(threads);
+  }
+  auto name = [](unsigned t) { return std::to_string(t) + "-threads"; };
+  if (std::none_of(thread_counts.begin(), thread_counts.end(), [&](unsigned t) {
+        return report.selected(Report::id("parse_file", name(t), n, 0));
+      })) {
+    return true;
+  }
+  std::random_device seed;
+  std::filesystem::path path =
+      std::filesystem::temp_directory_path() /
+      ("interp_bench_" + std::to_string(seed()) + ".txt");
+  std::vector<double> x, y;
+  make_nodes(n, x, y);
+  std::string text = "0.25 0.5 0.75\n";
+  for (std::size_t i = 0; i < n; i++) {
+    append_number(text, x[i]);
+    text += ' ';
+    append_number(text, y[i]);
+    text += '\n';
+  }
+  {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.write(text.data(), static_cast<std::streamsize>(text.size()))) {
+      return false;
+    }
+  }
+
+  for (unsigned t : thread_counts) {
+    report.run("parse_file", name(t), n, 0, text.size(), "bytes", [&] {
+      ParsingResult result = parse_file(path.string(), t);
+      sink = result.status ? result.x_values.back() : NAN;
+    });
+  }
+  std::error_code ignored;
+  std::filesystem::remove(path, ignored);
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  Options options;
+  int exit_code = 0;
+  if (!parse_options(argc, argv, options, exit_code)) {
+    return exit_code;
+  }
+#ifndef __OPTIMIZE__
+  std::fputs("interp_bench: warning: built without optimization\n", stderr);
+#endif
+
+  Report report(options);
+  for (std::size_t n : kNodeCounts) {
+    if (options.quick && n > 16384) {
+      break;
+    }
+    bench_methods(report, options, n);
+  }
+  if (!bench_parser(report, options)) {
+    std::fputs("interp_bench: cannot write a temporary node file\n", stderr);
+    return 1;
+  }
+
+  std::string json = report.json();
+  std::FILE *output = stdout;
+  if (!options.output.empty()) {
+    output = std::fopen(options.output.c_str(), "w");
+    if (output == nullptr) {
+      std::fprintf(stderr, "interp_bench: cannot open %s\n",
+                   options.output.c_str());
+      return 1;
+    }
+  }
+  std::fwrite(json.data(), 1, json.size(), output);
+  if (output != stdout && std::fclose(output) != 0) {
+    std::fprintf(stderr, "interp_bench: cannot write %s\n",
+                 options.output.c_str());
+    return 1;
+  }
+  return 0;
+}
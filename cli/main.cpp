@@ -0,0 +1,432 @@
+#include "file_parser.hpp"
+#include "interpolation_calc.hpp"
+#include "node_file.hpp"
+#include "node_set.hpp"
+#include "pipeline.hpp"
+#include "profiler.hpp"
+#include "snapshot.hpp"
+#include <charconv>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include "query_server.hpp"
+#endif
+
+static const char *kUsage =
+    R"(usage: interp_cli [options] FILE...
+       interp_cli --serve SOCKET [FILE...]
+
+Interpolates the nodes of each FILE and prints one line per query point:
+the query followed by the value of each selected method. FILE is a text node
+file (query points on the first line, then one "x y" pair per line) or a
+binary node file.
+
+options:
+  -m, --method NAME   lagrange, newton, newton-finite, stirling, bessel or
+                      all (default: newton)
+  -w, --window N      interpolate over N nodes around each query (default: 0,
+                      one global polynomial); N must be odd for stirling
+                      and even for bessel
+  -s, --stream        parse, build and evaluate in one pipelined pass; text
+                      files and the newton method only
+  -o, --output FILE   write the results to FILE instead of standard output
+  -c, --convert OUT   convert the text FILE to the binary node format OUT
+      --snapshot DIR  restore the interpolants of each FILE from a snapshot
+                      in DIR, or save one there after building them
+      --profile FILE  write per-stage timings and counters as JSON to FILE
+      --trace FILE    write the timed stages to FILE in the Chrome trace
+                      format (chrome://tracing, Perfetto); these two need a
+                      build with INTERP_PROFILING
+      --serve SOCKET  load the FILEs as tables 0, 1, ... and answer requests
+                      (see query_server.hpp) on the Unix domain socket
+                      SOCKET, or on standard input and output for '-'
+  -h, --help          show this help
+)";
+
+struct Options {
+  std::vector<IntepolationCalculator::InterpolationMethod> methods = {
+      IntepolationCalculator::NewtonSeparated};
+  int window = 0;
+  bool stream = false;
+  std::string output;
+  std::string convert;
+  std::string snapshot_dir;
+  std::string profile;
+  std::string trace;
+  std::string serve;
+  std::vector<std::string> files;
+};
+
+/**
+ * @brief Parses a method name as accepted by --method.
+ * @return False for an unknown name.
+ */
+static bool parse_method(
+    const std::string &name,
+    std::vector<IntepolationCalculator::InterpolationMethod> &methods) {
+  if (name == "all") {
+    methods = {IntepolationCalculator::Lagrange,
+               IntepolationCalculator::NewtonSeparated,
+               IntepolationCalculator::NewtonFinite,
+               IntepolationCalculator::Stirling,
+               IntepolationCalculator::Bessel};
+  } else if (name == "lagrange") {
+    methods = {IntepolationCalculator::Lagrange};
+  } else if (name == "newton") {
+    methods = {IntepolationCalculator::NewtonSeparated};
+  } else if (name == "newton-finite") {
+    methods = {IntepolationCalculator::NewtonFinite};
+  } else if (name == "stirling") {
+    methods = {IntepolationCalculator::Stirling};
+  } else if (name == "bessel") {
+    methods = {IntepolationCalculator::Bessel};
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Parses the command line.
+ * @return False after printing an error or the help text; exit_code is set.
+ */
+static bool parse_options(int argc, char *argv[], Options &options,
+                          int &exit_code) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto value = [&]() -> const char * {
+      return i + 1 < argc ? argv[++i] : nullptr;
+    };
+    // Stores the path after arg in target; an empty one would read as the
+    // option not being given, so it is missing too.
+    auto path_value = [&](std::string &target) {
+      const char *path = value();
+      if (path == nullptr || *path == '\0') {
+        std::fprintf(stderr, "interp_cli: missing value for '%s'\n",
+                     arg.c_str());
+        exit_code = 2;
+        return false;
+      }
+      target = path;
+      return true;
+    };
+    if (arg == "-h" || arg == "--help") {
+      std::fputs(kUsage, stdout);
+      exit_code = 0;
+      return false;
+    } else if (arg == "-m" || arg == "--method") {
+      const char *name = value();
+      if (name == nullptr || !parse_method(name, options.methods)) {
+        std::fprintf(stderr, "interp_cli: unknown method '%s'\n",
+                     name ? name : "");
+        exit_code = 2;
+        return false;
+      }
+    } else if (arg == "-w" || arg == "--window") {
+      const char *number = value();
+      const char *end = number ? number + std::strlen(number) : nullptr;
+      if (number == nullptr ||
+          std::from_chars(number, end, options.window).ptr != end ||
+          options.window < 0) {
+        std::fprintf(stderr, "interp_cli: invalid window '%s'\n",
+                     number ? number : "");
+        exit_code = 2;
+        return false;
+      }
+    } else if (arg == "-s" || arg == "--stream") {
+      options.stream = true;
+    } else if (arg == "-o" || arg == "--output") {
+      if (!path_value(options.output)) {
+        return false;
+      }
+    } else if (arg == "-c" || arg == "--convert") {
+      if (!path_value(options.convert)) {
+        return false;
+      }
+    } else if (arg == "--snapshot") {
+      if (!path_value(options.snapshot_dir)) {
+        return false;
+      }
+    } else if (arg == "--profile") {
+      if (!path_value(options.profile)) {
+        return false;
+      }
+    } else if (arg == "--trace") {
+      if (!path_value(options.trace)) {
+        return false;
+      }
+    } else if (arg == "--serve") {
+      if (!path_value(options.serve)) {
+        return false;
+      }
+    } else if (arg.size() > 1 && arg[0] == '-') {
+      std::fprintf(stderr, "interp_cli: unknown option '%s'\n%s", arg.c_str(),
+                   kUsage);
+      exit_code = 2;
+      return false;
+    } else {
+      options.files.push_back(arg);
+    }
+  }
+  if (options.files.empty() && options.serve.empty()) {
+    std::fputs(kUsage, stderr);
+    exit_code = 2;
+    return false;
+  }
+#ifndef INTERP_PROFILING
+  if (!options.profile.empty() || !options.trace.empty()) {
+    std::fputs("interp_cli: --profile and --trace need a build with "
+               "INTERP_PROFILING\n",
+               stderr);
+    exit_code = 2;
+    return false;
+  }
+#endif
+  if (options.stream &&
+      (options.methods.size() != 1 ||
+       options.methods[0] != IntepolationCalculator::NewtonSeparated)) {
+    std::fputs("interp_cli: --stream supports the newton method only\n",
+               stderr);
+    exit_code = 2;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Appends the shortest representation of value that reads back
+ * exactly.
+ */
+static void append_number(std::string &out, double value) {
+  char buffer[32];
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  out.append(buffer, result.ptr);
+}
+
+/**
+ * @brief Formats a parser error as "file:line:column: message".
+ */
+static std::string location(const std::string &file, std::size_t line,
+                            std::size_t column, const std::string &message) {
+  if (line == 0) {
+    return file + ": " + message;
+  }
+  return file + ":" + std::to_string(line) + ":" + std::to_string(column) +
+         ": " + message;
+}
+
+/**
+ * @brief Interpolates one file and appends its results to out.
+ * @return False with error set on failure; invalid nodes or options throw
+ * std::invalid_argument.
+ */
+static bool run_file(const Options &options, const std::string &file,
+                     NodeSetCache &cache, std::string &out,
+                     std::string &error) {
+  INTERP_PROFILE_SCOPE("run_file");
+  std::vector<double> queries;
+  std::vector<std::vector<double>> values;
+  if (options.stream) {
+    StreamResult result = stream_file(file, options.window);
+    if (!result.status) {
+      error = location(file, result.error_line, result.error_column,
+                       result.error_message);
+      return false;
+    }
+    queries = std::move(result.queries);
+    values.push_back(std::move(result.values));
+  } else {
+    std::shared_ptr<const NodeSet> nodes;
+    if (is_node_file(file)) {
+      NodeFile node_file = load_node_file(file);
+      if (!node_file.status) {
+        error = location(file, 0, 0, node_file.error_message);
+        return false;
+      }
+      queries = node_file.queries.to_vector();
+      nodes = cache.get(node_file.node_set());
+    } else {
+      ParsingResult parsed = parse_file(file);
+      if (!parsed.status) {
+        error = location(file, parsed.error_line, parsed.error_column,
+                         parsed.error_message);
+        return false;
+      }
+      queries = std::move(parsed.queries);
+      nodes = cache.get(std::move(parsed.x_values), std::move(parsed.y_values));
+    }
+    std::string snapshot;
+    std::size_t restored = 0;
+    if (!options.snapshot_dir.empty()) {
+      snapshot = options.snapshot_dir + "/" + snapshot_name(*nodes);
+      restored = load_snapshot(snapshot, nodes).interpolant_count;
+    }
+    for (auto method : options.methods) {
+      IntepolationCalculator calculator(method, nodes, options.window);
+      values.emplace_back(queries.size());
+      calculator.interpolate_many(queries.data(), queries.size(),
+                                  values.back().data());
+    }
+    std::size_t built = 0;
+    nodes->for_each_interpolant(
+        [&](int, int, const Interpolant &) { built++; });
+    if (!snapshot.empty() && built > restored &&
+        !save_snapshot(snapshot, *nodes)) {
+      error = location(file, 0, 0, "Cannot write snapshot " + snapshot);
+      return false;
+    }
+  }
+
+  if (options.files.size() > 1) {
+    out += "# " + file + "\n";
+  }
+  for (std::size_t i = 0; i < queries.size(); i++) {
+    append_number(out, queries[i]);
+    for (const auto &column : values) {
+      out += '\t';
+      append_number(out, column[i]);
+    }
+    out += '\n';
+  }
+  return true;
+}
+
+/**
+ * @brief Writes the --profile and --trace files of the run.
+ * @return False after printing an error.
+ */
+static bool write_profile(const Options &options) {
+  for (auto [path, text] :
+       {std::pair(&options.profile, &Profiler::to_json),
+        std::pair(&options.trace, &Profiler::to_chrome_trace)}) {
+    if (path->empty()) {
+      continue;
+    }
+    std::string contents = (Profiler::instance().*text)();
+    std::FILE *file = std::fopen(path->c_str(), "w");
+    bool written =
+        file != nullptr &&
+        std::fwrite(contents.data(), 1, contents.size(), file) ==
+            contents.size();
+    if (file != nullptr && std::fclose(file) != 0) {
+      written = false;
+    }
+    if (!written) {
+      std::fprintf(stderr, "interp_cli: cannot write %s\n", path->c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+#ifndef _WIN32
+/**
+ * @brief Runs the query daemon with the input files preloaded.
+ * @return Exit code; returns only on failure or when the pipe peer closes.
+ */
+static int serve(const Options &options) {
+  QueryServer server;
+  for (const auto &file : options.files) {
+    std::uint32_t table;
+    std::string error;
+    if (!server.load(file, table, error)) {
+      std::fprintf(stderr, "interp_cli: %s: %s\n", file.c_str(),
+                   error.c_str());
+      return 1;
+    }
+    std::fprintf(stderr, "interp_cli: table %u: %s\n", table, file.c_str());
+  }
+  if (options.serve == "-") {
+    // Sockets are written without SIGPIPE, but standard output may be a pipe.
+    std::signal(SIGPIPE, SIG_IGN);
+    server.serve_connection(STDIN_FILENO, STDOUT_FILENO);
+    return 0;
+  }
+  std::string error;
+  server.listen(options.serve, error);
+  std::fprintf(stderr, "interp_cli: %s: %s\n", options.serve.c_str(),
+               error.c_str());
+  return 1;
+}
+#endif
+
+int main(int argc, char *argv[]) {
+  Options options;
+  int exit_code = 0;
+  if (!parse_options(argc, argv, options, exit_code)) {
+    return exit_code;
+  }
+
+  if (!options.serve.empty()) {
+#ifndef _WIN32
+    return serve(options);
+#else
+    std::fputs("interp_cli: --serve is not supported on this platform\n",
+               stderr);
+    return 2;
+#endif
+  }
+
+  if (!options.convert.empty()) {
+    if (options.files.size() != 1) {
+      std::fputs("interp_cli: --convert takes exactly one input file\n",
+                 stderr);
+      return 2;
+    }
+    std::string error;
+    if (!convert_node_file(options.files[0], options.convert, error)) {
+      std::fprintf(stderr, "interp_cli: %s: %s\n", options.files[0].c_str(),
+                   error.c_str());
+      return 1;
+    }
+    return 0;
+  }
+
+  std::FILE *output = stdout;
+  if (!options.output.empty()) {
+    output = std::fopen(options.output.c_str(), "w");
+    if (output == nullptr) {
+      std::fprintf(stderr, "interp_cli: cannot open %s\n",
+                   options.output.c_str());
+      return 1;
+    }
+  }
+
+  INTERP_PROFILE_BEGIN_RUN();
+  NodeSetCache cache;
+  std::string out;
+  for (const auto &file : options.files) {
+    std::string error;
+    out.clear();
+    bool ok;
+    try {
+      ok = run_file(options, file, cache, out, error);
+    } catch (const std::invalid_argument &e) {
+      error = location(file, 0, 0, e.what());
+      ok = false;
+    }
+    if (!ok) {
+      std::fprintf(stderr, "interp_cli: %s\n", error.c_str());
+      exit_code = 1;
+      continue;
+    }
+    INTERP_PROFILE_SCOPE("write_output");
+    std::fwrite(out.data(), 1, out.size(), output);
+  }
+
+  if (output != stdout && std::fclose(output) != 0) {
+    std::fprintf(stderr, "interp_cli: cannot write %s\n",
+                 options.output.c_str());
+    return 1;
+  }
+  if (!write_profile(options)) {
+    return 1;
+  }
+  return exit_code;
+}
@@ -0,0 +1,230 @@
+#ifndef DA8045D1_BA28_46FE_BAB6_A32D05B110C7
+#define DA8045D1_BA28_46FE_BAB6_A32D05B110C7
+
+#include "parallel.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <vector>
+
+/**
+ * @brief Allocator returning memory aligned to Align bytes.
+ */
+template <class T, std::size_t Align = 64> struct AlignedAllocator {
+  using value_type = T;
+
+  template <class U> struct rebind {
+    using other = AlignedAllocator<U, Align>;
+  };
+
+  AlignedAllocator() = default;
+  template <class U> AlignedAllocator(const AlignedAllocator<U, Align> &) {}
+
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(
+        ::operator new(n * sizeof(T), std::align_val_t(Align)));
+  }
+
+  void deallocate(T *p, std::size_t) {
+    ::operator delete(p, std::align_val_t(Align));
+  }
+
+  template <class U> bool operator==(const AlignedAllocator<U, Align> &) const {
+    return true;
+  }
+  template <class U> bool operator!=(const AlignedAllocator<U, Align> &) const {
+    return false;
+  }
+};
+
+/**
+ * @brief Forward-difference table stored as a packed triangle.
+ *
+ * Entry (row, col) is the difference of order col at node row and exists for
+ * row + col < n. The table is stored column by column (order by order) in
+ * one cache-line aligned buffer of n (n + 1) / 2 values, so each order is
+ * built from the previous one with a single linear pass.
+ */
+class DifferenceTable {
+public:
+  /**
+   * @brief Contiguous view of all differences of one order.
+   */
+  class ColumnView {
+  public:
+    ColumnView(const double *data, std::size_t size)
+        : data_(data), size_(size) {}
+
+    const double *begin() const { return data_; }
+    const double *end() const { return data_ + size_; }
+    std::size_t size() const { return size_; }
+    double operator[](std::size_t i) const { return data_[i]; }
+
+  private:
+    const double *data_;
+    std::size_t size_;
+  };
+
+  /**
+   * @brief Strided view of the differences of every order at one node.
+   */
+  class RowView {
+  public:
+    class iterator {
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = double;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const double *;
+      using reference = const double &;
+
+      iterator(const double *p, std::size_t stride) : p(p), stride(stride) {}
+
+      reference operator*() const { return *p; }
+      iterator &operator++() {
+        p += stride--;
+        return *this;
+      }
+      iterator operator++(int) {
+        iterator it = *this;
+        ++*this;
+        return it;
+      }
+      bool operator==(const iterator &o) const { return p == o.p; }
+      bool operator!=(const iterator &o) const { return p != o.p; }
+
+    private:
+      const double *p;
+      std::size_t stride; ///< Length of the current column.
+    };
+
+    RowView(const DifferenceTable &table, std::size_t row)
+        : table(table), row(row) {}
+
+    iterator begin() const {
+      return iterator(table.data.data() + row, table.n);
+    }
+    iterator end() const {
+      return iterator(table.data.data() + table.offset(size()) + row,
+                      row + 1);
+    }
+    std::size_t size() const { return table.n - row; }
+    double operator[](std::size_t col) const { return table(row, col); }
+
+  private:
+    const DifferenceTable &table;
+    std::size_t row;
+  };
+
+  /**
+   * @brief Iterates over the rows of the table.
+   */
+  class row_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = RowView;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = RowView;
+
+    row_iterator(const DifferenceTable &table, std::size_t row)
+        : table(&table), row(row) {}
+
+    RowView operator*() const { return RowView(*table, row); }
+    row_iterator &operator++() {
+      ++row;
+      return *this;
+    }
+    bool operator==(const row_iterator &o) const { return row == o.row; }
+    bool operator!=(const row_iterator &o) const { return row != o.row; }
+
+  private:
+    const DifferenceTable *table;
+    std::size_t row;
+  };
+
+  DifferenceTable() = default;
+
+  /**
+   * @brief Builds the forward differences of the given values.
+   * @param y The node values.
+   * @param threads Number of threads, or 0 to choose from the table size.
+   * The result does not depend on it.
+   */
+  explicit DifferenceTable(const std::vector<double> &y, unsigned threads = 0)
+      : DifferenceTable(y.data(), y.size(), threads) {}
+
+  /**
+   * @brief Builds the forward differences of count values at y.
+   */
+  DifferenceTable(const double *y, std::size_t count, unsigned threads = 0)
+      : n(count), data(count * (count + 1) / 2) {
+    if (threads == 0) {
+      threads = auto_thread_count(n, kWavefrontMinRows);
+    }
+    std::copy(y, y + n, data.begin());
+    wavefront_sweep(n, threads, [this](std::size_t col, std::size_t begin,
+                                       std::size_t end) {
+      const double *prev = data.data() + offset(col - 1);
+      double *cur = data.data() + offset(col);
+      for (std::size_t row = begin; row < end; row++) {
+        cur[row] = prev[row + 1] - prev[row];
+      }
+    });
+  }
+
+  /**
+   * @brief Table over n nodes from the packed entries of another table.
+   * @param packed The n (n + 1) / 2 values returned by packed().
+   * @param n Number of nodes.
+   */
+  static DifferenceTable from_packed(const double *packed, std::size_t n) {
+    DifferenceTable table;
+    table.n = n;
+    table.data.assign(packed, packed + n * (n + 1) / 2);
+    return table;
+  }
+
+  /// Number of nodes.
+  std::size_t size() const { return n; }
+
+  /// All entries, column by column; n (n + 1) / 2 values.
+  const double *packed() const { return data.data(); }
+
+  /**
+   * @brief Difference of order col at node row; requires row + col < n.
+   */
+  double operator()(std::size_t row, std::size_t col) const {
+    return data[offset(col) + row];
+  }
+
+  /**
+   * @brief Difference of order col at node row, or 0 outside the triangle.
+   */
+  double at(int row, int col) const {
+    return row >= 0 && col >= 0 && static_cast<std::size_t>(row + col) < n
+               ? (*this)(row, col)
+               : 0.0;
+  }
+
+  ColumnView column(std::size_t col) const {
+    return ColumnView(data.data() + offset(col), n - col);
+  }
+  RowView row(std::size_t row) const { return RowView(*this, row); }
+  RowView front() const { return row(0); }
+
+  row_iterator begin() const { return row_iterator(*this, 0); }
+  row_iterator end() const { return row_iterator(*this, n); }
+
+private:
+  std::size_t n = 0;
+  std::vector<double, AlignedAllocator<double>> data;
+
+  /// Start of the column of order col.
+  std::size_t offset(std::size_t col) const {
+    return col * n - col * (col - 1) / 2;
+  }
+};
+
+#endif /* DA8045D1_BA28_46FE_BAB6_A32D05B110C7 */
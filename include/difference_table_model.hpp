@@ -0,0 +1,155 @@
+#ifndef C867DA03_7D16_4759_8A21_255D306452A0
+#define C867DA03_7D16_4759_8A21_255D306452A0
+
+#include "node_set.hpp"
+#include <QAbstractTableModel>
+#include <QString>
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief The nodes of a NodeSet and their forward differences as a table
+ * model: column 0 is x, column 1 is y and column k + 1 the difference of
+ * order k, which exists for the first n - k rows.
+ *
+ * Only the cells a view asks for are formatted, so a QTableView with fixed
+ * section sizes stays smooth for any number of nodes. Small node sets read
+ * the packed DifferenceTable of the NodeSet; larger ones, whose packed table
+ * would not fit in memory, show the first kMaxLazyOrder orders, computed a
+ * tile of rows at a time as they are scrolled into view.
+ */
+class DifferenceTableModel : public QAbstractTableModel {
+public:
+  /// Largest node count whose whole packed table is built and shown.
+  static constexpr std::size_t kMaxPackedNodes = 4096;
+  /// Highest order shown for node sets above kMaxPackedNodes.
+  static constexpr std::size_t kMaxLazyOrder = 64;
+  /// Rows computed at once above kMaxPackedNodes.
+  static constexpr std::size_t kTileRows = 256;
+  /// Tiles kept before the cache is dropped.
+  static constexpr std::size_t kMaxTiles = 64;
+
+  /**
+   * @param nodes The nodes; kept alive by the model.
+   * @param differences False to show only the x and y columns.
+   * @param parent Owner of the model.
+   */
+  DifferenceTableModel(std::shared_ptr<const NodeSet> nodes, bool differences,
+                       QObject *parent = nullptr)
+      : QAbstractTableModel(parent), nodes(std::move(nodes)),
+        n(this->nodes->x().size()) {
+    if (!differences || n == 0) {
+      orders = std::min<std::size_t>(n, 1);
+    } else if (this->nodes->has_difference_table() || n <= kMaxPackedNodes) {
+      table = &this->nodes->difference_table();
+      orders = n;
+    } else {
+      orders = std::min(n, kMaxLazyOrder + 1);
+    }
+  }
+
+  int rowCount(const QModelIndex &parent = QModelIndex()) const override {
+    return parent.isValid() ? 0 : static_cast<int>(n);
+  }
+
+  int columnCount(const QModelIndex &parent = QModelIndex()) const override {
+    return parent.isValid() ? 0 : static_cast<int>(1 + orders);
+  }
+
+  QVariant data(const QModelIndex &index,
+                int role = Qt::DisplayRole) const override {
+    if (!index.isValid()) {
+      return QVariant();
+    }
+    if (role == Qt::TextAlignmentRole) {
+      return static_cast<int>(Qt::AlignRight | Qt::AlignVCenter);
+    }
+    if (role != Qt::DisplayRole && role != Qt::ToolTipRole) {
+      return QVariant();
+    }
+    auto row = static_cast<std::size_t>(index.row());
+    auto col = static_cast<std::size_t>(index.column());
+    if (col > 0 && row + col > n) {
+      return QVariant(); // Below the triangle.
+    }
+    double value = col == 0 ? nodes->x()[row] : difference(row, col - 1);
+    if (role == Qt::ToolTipRole) {
+      return QString::number(value, 'g', 17);
+    }
+    return col <= 1 ? QString::number(value) : QString::number(value, 'f', 2);
+  }
+
+  QVariant headerData(int section, Qt::Orientation orientation,
+                      int role = Qt::DisplayRole) const override {
+    if (role != Qt::DisplayRole) {
+      return QVariant();
+    }
+    if (orientation == Qt::Vertical) {
+      return section;
+    }
+    switch (section) {
+    case 0:
+      return QStringLiteral("x");
+    case 1:
+      return QStringLiteral("y");
+    case 2:
+      return QString::fromUtf8("Δy");
+    default:
+      return QString::fromUtf8("Δ^%1y").arg(section - 1);
+    }
+  }
+
+private:
+  std::shared_ptr<const NodeSet> nodes;
+  std::size_t n;
+  std::size_t orders; ///< Difference columns shown, order 0 (y) included.
+  const DifferenceTable *table = nullptr; ///< Null above kMaxPackedNodes.
+  /// Rows of orders differences each, by tile index.
+  mutable std::unordered_map<std::size_t, std::vector<double>> tiles;
+
+  /// Difference of order at row; requires row + order < n.
+  double difference(std::size_t row, std::size_t order) const {
+    if (table) {
+      return (*table)(row, order);
+    }
+    if (order == 0) {
+      return nodes->y()[row];
+    }
+    return tile(row / kTileRows)[(row % kTileRows) * orders + order];
+  }
+
+  /**
+   * @brief Differences of the rows of tile t, built with the recurrence of
+   * DifferenceTable so the values match it exactly.
+   */
+  const std::vector<double> &tile(std::size_t t) const {
+    if (auto it = tiles.find(t); it != tiles.end()) {
+      return it->second;
+    }
+    if (tiles.size() >= kMaxTiles) {
+      tiles.clear();
+    }
+    std::size_t first = t * kTileRows;
+    std::size_t rows = std::min(kTileRows, n - first);
+    // Order k of row r needs y up to r + k.
+    std::size_t span = std::min(n - first, rows + orders - 1);
+    const double *y = nodes->y().data() + first;
+    std::vector<double> column(y, y + span);
+    std::vector<double> result(rows * orders);
+    for (std::size_t k = 0; k < orders; k++) {
+      for (std::size_t r = 0; r < rows && r + k < span; r++) {
+        result[r * orders + k] = column[r];
+      }
+      for (std::size_t i = 0; i + k + 1 < span; i++) {
+        column[i] = column[i + 1] - column[i];
+      }
+    }
+    return tiles.emplace(t, std::move(result)).first->second;
+  }
+};
+
+#endif /* C867DA03_7D16_4759_8A21_255D306452A0 */
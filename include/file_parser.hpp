@@ -1,47 +1,300 @@
 #ifndef CBB2EA86_08B9_4952_BF85_D67124FC4973
 #define CBB2EA86_08B9_4952_BF85_D67124FC4973
-#include <fstream>
-#include <sstream>
+#include "mapped_file.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <system_error>
 #include <utility>
 #include <vector>
 
 struct ParsingResult {
   bool status = false;
-  double firstValue = 0.0;
+  double firstValue = 0.0;     ///< The first query point.
+  std::vector<double> queries; ///< All query points, in file order.
   std::vector<double> x_values;
   std::vector<double> y_values;
+  std::size_t error_line = 0;   ///< 1-based line of the error, 0 if none.
+  std::size_t error_column = 0; ///< 1-based column of the error.
+  std::string error_message;
 };
 
-inline ParsingResult parse_file(const std::string &filename) {
-  double firstValue;
-  std::vector<double> x_values;
-  std::vector<double> y_values;
-  std::ifstream file(filename);
+/**
+ * @brief Position in a text buffer that keeps track of its line and column.
+ */
+class TextCursor {
+public:
+  TextCursor(const char *begin, const char *end, std::size_t line = 1)
+      : p(begin), end(end), line_start(begin), line_(line) {}
+
+  /// True at the end of the buffer.
+  bool at_end() const { return p == end; }
+
+  /// True at a line break or the end of the buffer.
+  bool at_line_end() const { return p == end || *p == '\n'; }
+
+  /**
+   * @brief Skips spaces, tabs and carriage returns within the line.
+   */
+  void skip_blanks() {
+    while (p != end && is_blank(*p)) {
+      ++p;
+    }
+  }
+
+  /**
+   * @brief Moves to the start of the next line.
+   */
+  void next_line() {
+    p = std::find(p, end, '\n');
+    if (p != end) {
+      ++p;
+      line_start = p;
+      line_++;
+    }
+  }
+
+  /**
+   * @brief Reads a finite number at the cursor.
+   * @param value Receives the number.
+   * @param delimited If true, the number must be followed by a blank or the
+   * end of the line; otherwise reading stops after it, as operator>> would.
+   * @return nullptr on success, otherwise a description of the error; the
+   * cursor then stays on the offending token.
+   */
+  const char *number(double &value, bool delimited = true) {
+    const char *first = p;
+    if (first != end && *first == '+' && first + 1 != end &&
+        first[1] != '-') {
+      ++first;
+    }
+    auto [last, ec] = std::from_chars(first, end, value);
+    if (ec == std::errc::result_out_of_range) {
+      return "Number out of range";
+    }
+    if (ec != std::errc() || (delimited && last != end && !is_blank(*last) &&
+                              *last != '\n')) {
+      return "Malformed number";
+    }
+    if (!std::isfinite(value)) {
+      // from_chars reads "inf" and "nan", which would poison every
+      // difference.
+      return "Number is not finite";
+    }
+    p = last;
+    return nullptr;
+  }
+
+  const char *position() const { return p; }
+  std::size_t line() const { return line_; }
+  std::size_t column() const {
+    return static_cast<std::size_t>(p - line_start) + 1;
+  }
+
+private:
+  const char *p, *end, *line_start;
+  std::size_t line_;
+
+  static bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+  }
+};
+
+/**
+ * @brief Parses the query line, one or more values separated by blanks, and
+ * moves to the next line.
+ * @param cursor Start of the line; on error it is left at the fault.
+ * @param queries Receives the query values.
+ * @return nullptr on success, otherwise a description of the error.
+ */
+inline const char *parse_query_line(TextCursor &cursor,
+                                    std::vector<double> &queries) {
+  queries.clear();
+  cursor.skip_blanks();
+  if (cursor.at_line_end()) {
+    return "Missing query value";
+  }
+  while (!cursor.at_line_end()) {
+    double value;
+    if (const char *error = cursor.number(value)) {
+      return error;
+    }
+    queries.push_back(value);
+    cursor.skip_blanks();
+  }
+  cursor.next_line();
+  return nullptr;
+}
+
+/**
+ * @brief Parses one "x y" row on a line that is not blank; any text after y
+ * is ignored, as it always has been.
+ * @param cursor Start of the row; on error it is left at the fault.
+ * @param x Receives the x-coordinate.
+ * @param y Receives the y-coordinate.
+ * @return nullptr on success, otherwise a description of the error.
+ */
+inline const char *parse_node_row(TextCursor &cursor, double &x, double &y) {
+  if (const char *error = cursor.number(x)) {
+    return error;
+  }
+  cursor.skip_blanks();
+  if (cursor.at_line_end()) {
+    return "Missing y value";
+  }
+  return cursor.number(y, false);
+}
+
+/**
+ * @brief Parses "x y" rows up to the end of the cursor's buffer, skipping
+ * blank lines.
+ * @param cursor Start of the first row; on error it is left at the fault.
+ * @param x Receives the x-coordinates; must have room for every row.
+ * @param y Receives the y-coordinates; must have room for every row.
+ * @param count Receives the number of rows read.
+ * @return nullptr on success, otherwise a description of the error.
+ */
+inline const char *parse_node_rows(TextCursor &cursor, double *x, double *y,
+                                   std::size_t &count) {
+  count = 0;
+  for (; !cursor.at_end(); cursor.next_line()) {
+    cursor.skip_blanks();
+    if (cursor.at_line_end()) {
+      continue;
+    }
+    if (const char *error = parse_node_row(cursor, x[count], y[count])) {
+      return error;
+    }
+    count++;
+  }
+  return nullptr;
+}
+
+/// Fewest bytes per thread for which parse_file() splits the node rows.
+constexpr std::size_t kParseMinBytes = std::size_t(1) << 20;
+
+/**
+ * @brief Parses a node file: the query points on the first line, then one
+ * "x y" pair per line.
+ *
+ * The file is memory-mapped and scanned in place with std::from_chars. The
+ * node rows are split into newline-aligned chunks, one per thread. A first
+ * pass counts the lines of every chunk, which gives each chunk its first line
+ * number and its place in the output, sized once; a second pass parses all
+ * chunks straight into the output. Blank lines leave gaps that are closed by
+ * moving the later rows down, so files without them are never copied.
+ * @param filename Path to the file.
+ * @param threads Number of threads, or 0 to choose from the file size.
+ * @return The parsed values, or status = false with the line, column and
+ * reason of the first error.
+ */
+inline ParsingResult parse_file(const std::string &filename,
+                                unsigned threads = 0) {
+  INTERP_PROFILE_SCOPE("parse_file");
+  ParsingResult result;
+  MappedFile file(filename);
   if (!file.is_open()) {
-    return ParsingResult{false, 0.0, {}, {}};
-  }
-  std::string line;
-  // Read the first line separately to get the first value
-  if (std::getline(file, line)) {
-    std::istringstream iss(line);
-    if (!(iss >> firstValue)) {
-      return ParsingResult{false, 0.0, {}, {}};
-    }
-  } else {
-    return ParsingResult{false, 0.0, {}, {}};
-  }
-  // Read the rest of the file for x and y values
-  while (std::getline(file, line)) {
-    std::istringstream iss(line);
-    double x, y;
-    if (!(iss >> x >> y)) {
-      return ParsingResult{false, 0.0, {}, {}};
-    }
-    x_values.push_back(x);
-    y_values.push_back(y);
-  }
-  file.close();
-  return ParsingResult{true, firstValue, x_values, y_values};
+    result.error_message = "Cannot open file";
+    return result;
+  }
+
+  TextCursor cursor(file.begin(), file.end());
+  auto fail = [&](std::size_t line, std::size_t column, const char *message) {
+    result.error_line = line;
+    result.error_column = column;
+    result.error_message = message;
+    result.queries.clear();
+    result.x_values.clear();
+    result.y_values.clear();
+    return std::move(result);
+  };
+
+  if (const char *error = parse_query_line(cursor, result.queries)) {
+    return fail(cursor.line(), cursor.column(), error);
+  }
+  result.firstValue = result.queries.front();
+
+  const char *rows_begin = cursor.position();
+  std::size_t bytes = static_cast<std::size_t>(file.end() - rows_begin);
+  if (threads == 0) {
+    threads = auto_thread_count(bytes, kParseMinBytes);
+  }
+
+  struct Chunk {
+    const char *begin, *end;
+    std::size_t first_line = 0; ///< Line number of begin.
+    std::size_t offset = 0;     ///< First output row.
+    std::size_t lines = 0;      ///< Number of lines, an upper bound on rows.
+    std::size_t rows = 0;       ///< Number of rows parsed.
+    const char *error = nullptr;
+    std::size_t error_line = 0, error_column = 0;
+  };
+  std::vector<Chunk> chunks(threads);
+  const char *split = rows_begin;
+  for (unsigned i = 0; i < threads; i++) {
+    const char *stop = rows_begin + bytes * (i + 1) / threads;
+    if (stop < split) {
+      stop = split;
+    } else if (stop != file.end()) {
+      stop = std::find(stop, file.end(), '\n');
+      stop += stop != file.end();
+    }
+    chunks[i].begin = split;
+    chunks[i].end = stop;
+    split = stop;
+  }
+
+  run_parallel(threads, [&](unsigned id) {
+    Chunk &chunk = chunks[id];
+    chunk.lines =
+        static_cast<std::size_t>(std::count(chunk.begin, chunk.end, '\n'));
+    if (chunk.begin != chunk.end && chunk.end[-1] != '\n') {
+      chunk.lines++;
+    }
+  });
+  std::size_t rows = 0;
+  for (auto &chunk : chunks) {
+    chunk.first_line = cursor.line() + rows;
+    chunk.offset = rows;
+    rows += chunk.lines;
+  }
+  result.x_values.resize(rows);
+  result.y_values.resize(rows);
+
+  run_parallel(threads, [&](unsigned id) {
+    INTERP_PROFILE_SCOPE("parse_file.chunk");
+    Chunk &chunk = chunks[id];
+    TextCursor chunk_cursor(chunk.begin, chunk.end, chunk.first_line);
+    chunk.error = parse_node_rows(
+        chunk_cursor, result.x_values.data() + chunk.offset,
+        result.y_values.data() + chunk.offset, chunk.rows);
+    chunk.error_line = chunk_cursor.line();
+    chunk.error_column = chunk_cursor.column();
+  });
+
+  rows = 0;
+  for (const auto &chunk : chunks) {
+    if (chunk.error != nullptr) {
+      return fail(chunk.error_line, chunk.error_column, chunk.error);
+    }
+    if (rows != chunk.offset) {
+      std::copy_n(result.x_values.begin() + chunk.offset, chunk.rows,
+                  result.x_values.begin() + rows);
+      std::copy_n(result.y_values.begin() + chunk.offset, chunk.rows,
+                  result.y_values.begin() + rows);
+    }
+    rows += chunk.rows;
+  }
+  result.x_values.resize(rows);
+  result.y_values.resize(rows);
+  INTERP_PROFILE_COUNT("parse_file.bytes", file.size());
+  INTERP_PROFILE_COUNT("parse_file.nodes", rows);
+  result.status = true;
+  return result;
 }
 
 #endif /* CBB2EA86_08B9_4952_BF85_D67124FC4973 */
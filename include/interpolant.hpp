@@ -0,0 +1,889 @@
+#ifndef A0EC0C96_7131_4E40_8651_A0B7C9F65982
+#define A0EC0C96_7131_4E40_8651_A0B7C9F65982
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+/**
+ * @brief Shared evaluation front-end for the concrete interpolant types.
+ *
+ * Derived classes provide `template <int L> void kernel(const double *v,
+ * double *out) const`, which evaluates L queries at once. The query loop is
+ * kept innermost and branch-free in every kernel so that the compiler can
+ * vectorise it for the target ISA.
+ *
+ * They also provide `template <class Self, class F> static void fields(Self
+ * &self, F &&f)`, which calls f on each data member of self in a fixed order,
+ * so that snapshot.hpp can save and restore them without further accessors.
+ */
+template <class Derived> class InterpolantBase {
+public:
+  /// Number of queries evaluated together by evaluate_many().
+  static constexpr int kBatchLanes = 8;
+
+  /**
+   * @brief Evaluates the interpolant at a single point.
+   * @param v The point.
+   * @return Interpolated value.
+   */
+  double operator()(double v) const {
+    double result;
+    derived().template kernel<1>(&v, &result);
+    return result;
+  }
+
+  /**
+   * @brief Evaluates the interpolant at many points.
+   * @param queries Pointer to count query points.
+   * @param count Number of query points.
+   * @param out Pointer to count output values.
+   */
+  void evaluate_many(const double *queries, std::size_t count,
+                     double *out) const {
+    std::size_t i = 0;
+    for (; i + kBatchLanes <= count; i += kBatchLanes) {
+      derived().template kernel<kBatchLanes>(queries + i, out + i);
+    }
+    for (; i < count; i++) {
+      derived().template kernel<1>(queries + i, out + i);
+    }
+  }
+
+private:
+  const Derived &derived() const { return static_cast<const Derived &>(*this); }
+};
+
+/**
+ * @brief Sums a Newton series by nested (Horner) multiplication for L queries.
+ *
+ * Like the other series kernels below, the term of order i for lane l is read
+ * from c[i * ci + l * cl] (and the node from nodes[i * ci + l * cl]), so one
+ * kernel serves both a coefficient set shared by all queries (ci = 1, cl = 0)
+ * and per-query sets gathered by WindowedInterpolant (ci = L, cl = 1).
+ * @param v The L query points.
+ * @param nodes Nodes x_0, ..., x_{order - 1}.
+ * @param c Divided differences of order 0..order.
+ * @param ci Stride between orders.
+ * @param cl Stride between lanes.
+ * @param order Degree of the polynomial.
+ * @param out The L results.
+ */
+template <int L>
+void newton_series(const double *v, const double *nodes, const double *c,
+                   int ci, int cl, int order, double *out) {
+  double result[L];
+  for (int l = 0; l < L; l++) {
+    result[l] = c[order * ci + l * cl];
+  }
+  for (int i = order - 1; i >= 0; i--) {
+    for (int l = 0; l < L; l++) {
+      result[l] = result[l] * (v[l] - nodes[i * ci + l * cl]) + c[i * ci + l * cl];
+    }
+  }
+  std::copy(result, result + L, out);
+}
+
+/**
+ * @brief Sums the Newton forward series in t = (v - x_0) / h for L queries.
+ *
+ * term = t (t - 1) ... (t - i + 1) / i! is built up in the same pass.
+ */
+template <int L>
+void forward_series(const double *t, const double *c, int ci, int cl,
+                    int order, double *out) {
+  double term[L], result[L];
+  for (int l = 0; l < L; l++) {
+    term[l] = 1;
+    result[l] = c[l * cl];
+  }
+  for (int i = 1; i <= order; i++) {
+    for (int l = 0; l < L; l++) {
+      term[l] *= (t[l] - (i - 1)) / i;
+      result[l] += term[l] * c[i * ci + l * cl];
+    }
+  }
+  std::copy(result, result + L, out);
+}
+
+/**
+ * @brief Sums the Stirling series in t = (v - a) / h for L queries.
+ *
+ * The even and odd t-polynomials t^2 (t^2 - 1) ... / k! and
+ * t (t^2 - 1) ... / k! are carried separately, so no step divides by t.
+ */
+template <int L>
+void stirling_series(const double *t, const double *c, int ci, int cl,
+                     int order, double *out) {
+  double t2[L], even[L], odd[L], result[L];
+  for (int l = 0; l < L; l++) {
+    t2[l] = t[l] * t[l];
+    even[l] = 1;
+    odd[l] = t[l];
+    result[l] = c[l * cl] + (order > 0 ? t[l] * c[ci + l * cl] : 0);
+  }
+  for (int k = 2; k <= order; k++) {
+    double s = (k - 1) / 2;
+    double denom = static_cast<double>(k) * (k - 1);
+    double *term = k % 2 == 0 ? even : odd;
+    for (int l = 0; l < L; l++) {
+      term[l] *= (t2[l] - s * s) / denom;
+      result[l] += term[l] * c[k * ci + l * cl];
+    }
+  }
+  std::copy(result, result + L, out);
+}
+
+/**
+ * @brief Sums the Bessel series in t = (v - a) / h for L queries.
+ *
+ * Odd orders reuse the preceding even t-polynomial times (t - 1/2) / k, so no
+ * step divides by (t - 1/2).
+ */
+template <int L>
+void bessel_series(const double *t, const double *c, int ci, int cl,
+                   int order, double *out) {
+  double even[L], result[L];
+  for (int l = 0; l < L; l++) {
+    even[l] = 1;
+    result[l] = c[l * cl];
+  }
+  for (int k = 1; k <= order; k++) {
+    if (k % 2 == 0) {
+      double denom = static_cast<double>(k) * (k - 1);
+      for (int l = 0; l < L; l++) {
+        even[l] *= (t[l] + (k / 2 - 1)) * (t[l] - k / 2) / denom;
+        result[l] += even[l] * c[k * ci + l * cl];
+      }
+    } else {
+      for (int l = 0; l < L; l++) {
+        result[l] += even[l] * (t[l] - 0.5) / k * c[k * ci + l * cl];
+      }
+    }
+  }
+  std::copy(result, result + L, out);
+}
+
+/**
+ * @brief Highest order used by the Stirling formula over nodes 0..n.
+ */
+constexpr int stirling_order(int n) { return std::min(n, std::max(2, n - 1)); }
+
+/**
+ * @brief Coefficient of order k in the Stirling formula over nodes 0..n,
+ * centred at node n / 2.
+ * @param at Returns the forward difference of order col at node row, or 0
+ * outside the table.
+ * @return The central difference, or the mean of the two for odd k.
+ */
+template <class At>
+constexpr double stirling_coefficient(const At &at, int n, int k) {
+  int center = n / 2;
+  return k % 2 == 0
+             ? at(center - k / 2, k)
+             : (at(center - k / 2 - 1, k) + at(center - k / 2, k)) / 2;
+}
+
+/**
+ * @brief Coefficient of order k in the Bessel formula over nodes 0..n,
+ * centred between nodes n / 2 and n / 2 + 1.
+ * @param at Returns the forward difference of order col at node row, or 0
+ * outside the table.
+ * @return The central difference, or the mean of the two for even k.
+ */
+template <class At>
+constexpr double bessel_coefficient(const At &at, int n, int k) {
+  int center = n / 2;
+  return k % 2 == 0
+             ? (at(center - k / 2, k) + at(center - k / 2 + 1, k)) / 2
+             : at(center - k / 2, k);
+}
+
+/**
+ * @brief Lagrange polynomial in the second barycentric form.
+ */
+class LagrangeInterpolant : public InterpolantBase<LagrangeInterpolant> {
+public:
+  LagrangeInterpolant() = default;
+
+  /**
+   * @param x The nodes.
+   * @param y The node values.
+   * @param weights Barycentric weights of the nodes.
+   */
+  LagrangeInterpolant(std::vector<double> x, std::vector<double> y,
+                      std::vector<double> weights)
+      : x(std::move(x)), y(std::move(y)), weights(std::move(weights)) {}
+
+  /**
+   * @brief Evaluates L queries in O(n) each.
+   *
+   * The node loop is branch-free; a query that hits a node exactly makes the
+   * denominator infinite and is resolved to the node value afterwards.
+   */
+  template <int L> void kernel(const double *v, double *out) const {
+    double num[L] = {};
+    double den[L] = {};
+    for (int i = 0; i < static_cast<int>(x.size()); i++) {
+      for (int l = 0; l < L; l++) {
+        double c = weights[i] / (v[l] - x[i]);
+        num[l] += c * y[i];
+        den[l] += c;
+      }
+    }
+    for (int l = 0; l < L; l++) {
+      out[l] = num[l] / den[l];
+      if (!std::isfinite(den[l])) {
+        auto it = std::find(x.begin(), x.end(), v[l]);
+        if (it != x.end()) {
+          out[l] = y[it - x.begin()];
+        }
+      }
+    }
+  }
+
+  template <class Self, class F> static void fields(Self &self, F &&f) {
+    f(self.x);
+    f(self.y);
+    f(self.weights);
+  }
+
+private:
+  std::vector<double> x, y, weights;
+};
+
+/**
+ * @brief Newton polynomial over divided differences f[x_0, ..., x_i].
+ */
+class NewtonInterpolant : public InterpolantBase<NewtonInterpolant> {
+public:
+  NewtonInterpolant() = default;
+
+  /**
+   * @param x The nodes.
+   * @param coeffs Divided differences f[x_0, ..., x_i].
+   * @param tail Divided differences f[x_i, ..., x_{n-1}] ending at the last
+   * node, used by add_node().
+   */
+  NewtonInterpolant(std::vector<double> x, std::vector<double> coeffs,
+                    std::vector<double> tail)
+      : x(std::move(x)), coeffs(std::move(coeffs)), tail(std::move(tail)) {}
+
+  /**
+   * @brief Appends a node and updates the polynomial in O(n).
+   *
+   * Extending the divided-difference table by one node only needs its bottom
+   * diagonal; the new top entry f[x_0, ..., x_n] is the coefficient of the
+   * added term, and all existing coefficients stay unchanged.
+   * @param xn The new node, distinct from the existing ones.
+   * @param yn The value at the new node.
+   */
+  void add_node(double xn, double yn) {
+    if (std::find(x.begin(), x.end(), xn) != x.end()) {
+      throw std::invalid_argument("Node already exists");
+    }
+    tail.push_back(yn);
+    for (int i = static_cast<int>(x.size()) - 1; i >= 0; i--) {
+      tail[i] = (tail[i + 1] - tail[i]) / (xn - x[i]);
+    }
+    x.push_back(xn);
+    coeffs.push_back(tail.front());
+  }
+
+  /// Divided differences f[x_0, ..., x_i].
+  const std::vector<double> &coefficients() const { return coeffs; }
+
+  /**
+   * @brief Evaluates L queries by nested (Horner) multiplication in O(n)
+   * each.
+   */
+  template <int L> void kernel(const double *v, double *out) const {
+    newton_series<L>(v, x.data(), coeffs.data(), 1, 0,
+                     static_cast<int>(coeffs.size()) - 1, out);
+  }
+
+  template <class Self, class F> static void fields(Self &self, F &&f) {
+    f(self.x);
+    f(self.coeffs);
+    f(self.tail);
+  }
+
+private:
+  std::vector<double> x, coeffs;
+  std::vector<double> tail; ///< f[x_i, ..., x_{n-1}], see add_node().
+};
+
+/**
+ * @brief Newton forward polynomial over equally spaced nodes.
+ */
+class NewtonFiniteInterpolant
+    : public InterpolantBase<NewtonFiniteInterpolant> {
+public:
+  NewtonFiniteInterpolant() = default;
+
+  /**
+   * @param x0 The first node.
+   * @param h The node spacing; ignored while there is only one node.
+   * @param coeffs Forward differences of y_0 of order 0..n, for nodes
+   * x_0..x_n.
+   * @param tail Forward differences of order k of y_{n-k}, used by
+   * add_node().
+   */
+  NewtonFiniteInterpolant(double x0, double h, std::vector<double> coeffs,
+                          std::vector<double> tail)
+      : x0(x0), h(h), coeffs(std::move(coeffs)), tail(std::move(tail)) {}
+
+  /**
+   * @brief Appends the next equally spaced node in O(n).
+   *
+   * Updates the bottom diagonal of the forward-difference table; its last
+   * entry is the new highest-order difference of y_0. The first two nodes
+   * fix x_0 and h.
+   * @param xn The new node, which must equal x_0 + n h from the third node
+   * on.
+   * @param yn The value at the new node.
+   */
+  void add_node(double xn, double yn) {
+    if (coeffs.empty()) {
+      x0 = xn;
+    } else if (coeffs.size() == 1) {
+      if (xn == x0) {
+        throw std::invalid_argument("Node already exists");
+      }
+      h = xn - x0;
+    } else {
+      double expected = x0 + static_cast<double>(coeffs.size()) * h;
+      if (std::abs(xn - expected) >
+          1e-9 * std::max(1.0, std::abs(expected))) {
+        throw std::invalid_argument("Node breaks the uniform spacing");
+      }
+    }
+    double carry = yn;
+    for (auto &d : tail) {
+      double prev = d;
+      d = carry;
+      carry -= prev;
+    }
+    tail.push_back(carry);
+    coeffs.push_back(carry);
+  }
+
+  template <int L> void kernel(const double *v, double *out) const {
+    double t[L];
+    for (int l = 0; l < L; l++) {
+      t[l] = (v[l] - x0) / h;
+    }
+    forward_series<L>(t, coeffs.data(), 1, 0,
+                      static_cast<int>(coeffs.size()) - 1, out);
+  }
+
+  template <class Self, class F> static void fields(Self &self, F &&f) {
+    f(self.x0);
+    f(self.h);
+    f(self.coeffs);
+    f(self.tail);
+  }
+
+private:
+  double x0 = 0, h = 1;
+  std::vector<double> coeffs;
+  std::vector<double> tail; ///< Differences of order k of y_{n-k}.
+};
+
+/**
+ * @brief Stirling central-difference polynomial.
+ */
+class StirlingInterpolant : public InterpolantBase<StirlingInterpolant> {
+public:
+  StirlingInterpolant() = default;
+
+  /**
+   * @param a The centre node.
+   * @param h The node spacing.
+   * @param coeffs Central difference (or mean of the two) of each order.
+   */
+  StirlingInterpolant(double a, double h, std::vector<double> coeffs)
+      : a(a), h(h), coeffs(std::move(coeffs)) {}
+
+  template <int L> void kernel(const double *v, double *out) const {
+    double t[L];
+    for (int l = 0; l < L; l++) {
+      t[l] = (v[l] - a) / h;
+    }
+    stirling_series<L>(t, coeffs.data(), 1, 0,
+                       static_cast<int>(coeffs.size()) - 1, out);
+  }
+
+  template <class Self, class F> static void fields(Self &self, F &&f) {
+    f(self.a);
+    f(self.h);
+    f(self.coeffs);
+  }
+
+private:
+  double a = 0, h = 1;
+  std::vector<double> coeffs;
+};
+
+/**
+ * @brief Bessel central-difference polynomial.
+ */
+class BesselInterpolant : public InterpolantBase<BesselInterpolant> {
+public:
+  BesselInterpolant() = default;
+
+  /**
+   * @param a The centre node.
+   * @param h The node spacing.
+   * @param coeffs Central difference (or mean of the two) of each order.
+   */
+  BesselInterpolant(double a, double h, std::vector<double> coeffs)
+      : a(a), h(h), coeffs(std::move(coeffs)) {}
+
+  template <int L> void kernel(const double *v, double *out) const {
+    double t[L];
+    for (int l = 0; l < L; l++) {
+      t[l] = (v[l] - a) / h;
+    }
+    bessel_series<L>(t, coeffs.data(), 1, 0,
+                     static_cast<int>(coeffs.size()) - 1, out);
+  }
+
+  template <class Self, class F> static void fields(Self &self, F &&f) {
+    f(self.a);
+    f(self.h);
+    f(self.coeffs);
+  }
+
+private:
+  double a = 0, h = 1;
+  std::vector<double> coeffs;
+};
+
+/**
+ * @brief Local interpolation over a sliding window of nodes.
+ *
+ * Holds the nodes sorted by x together with a banded difference table that
+ * keeps only the orders below the window size, so building costs O(n k)
+ * time and memory. Each query binary-searches its position, takes the k
+ * nodes around it and evaluates a degree k - 1 polynomial there in
+ * O(log n + k).
+ */
+class WindowedInterpolant : public InterpolantBase<WindowedInterpolant> {
+public:
+  /// Polynomial form evaluated inside the window.
+  enum Form {
+    Divided,  ///< Newton divided differences, any node spacing.
+    Forward,  ///< Newton forward differences, equal spacing.
+    Stirling, ///< Stirling central differences, equal spacing.
+    Bessel    ///< Bessel central differences, equal spacing.
+  };
+
+  /// Largest supported window, bounding the per-query scratch space.
+  static constexpr int kMaxWindow = 32;
+
+  WindowedInterpolant() = default;
+
+  /**
+   * @param form The polynomial form.
+   * @param window Number of nodes per window, 1..kMaxWindow.
+   * @param x The nodes, sorted ascending.
+   * @param table Row-major n x window table; entry (j, m) holds the
+   * difference of order m starting at node j (divided for Divided, forward
+   * otherwise), or 0 where j + m >= n.
+   */
+  WindowedInterpolant(Form form, int window, std::vector<double> x,
+                      std::vector<double> table)
+      : form(form), window(window), x(std::move(x)), table(std::move(table)) {
+    h = this->x.size() > 1 ? this->x[1] - this->x[0] : 1;
+  }
+
+  /**
+   * @brief Index of the first node of the window used for v.
+   */
+  int window_start(double v) const {
+    int n = static_cast<int>(x.size());
+    int idx = static_cast<int>(std::upper_bound(x.begin(), x.end(), v) -
+                               x.begin());
+    return std::clamp(idx - window / 2, 0, n - window);
+  }
+
+  template <int L> void kernel(const double *v, double *out) const {
+    // The constructor requires this; spelled out so the compiler can see
+    // that c and nodes are written for every order the series read.
+    int k = std::clamp(window, 1, kMaxWindow);
+    double t[L];
+    double c[kMaxWindow * L];
+    double nodes[kMaxWindow * L];
+    for (int l = 0; l < L; l++) {
+      int s = window_start(v[l]);
+      const double *row = &table[static_cast<std::size_t>(s) * k];
+      auto at = [&](int r, int m) {
+        return r >= 0 && r + m < k ? row[r * k + m] : 0.0;
+      };
+      switch (form) {
+      case Divided:
+        for (int i = 0; i < k; i++) {
+          c[i * L + l] = row[i];
+          nodes[i * L + l] = x[s + i];
+        }
+        break;
+      case Forward:
+        t[l] = (v[l] - x[s]) / h;
+        for (int i = 0; i < k; i++) {
+          c[i * L + l] = row[i];
+        }
+        break;
+      case Stirling:
+        t[l] = (v[l] - x[s + (k - 1) / 2]) / h;
+        for (int i = 0; i <= stirling_order(k - 1); i++) {
+          c[i * L + l] = stirling_coefficient(at, k - 1, i);
+        }
+        break;
+      case Bessel:
+        t[l] = (v[l] - x[s + (k - 1) / 2]) / h;
+        for (int i = 0; i < k; i++) {
+          c[i * L + l] = bessel_coefficient(at, k - 1, i);
+        }
+        break;
+      }
+    }
+
+    switch (form) {
+    case Divided:
+      return newton_series<L>(v, nodes, c, L, 1, k - 1, out);
+    case Forward:
+      return forward_series<L>(t, c, L, 1, k - 1, out);
+    case Stirling:
+      return stirling_series<L>(t, c, L, 1, stirling_order(k - 1), out);
+    case Bessel:
+      return bessel_series<L>(t, c, L, 1, k - 1, out);
+    }
+  }
+
+  template <class Self, class F> static void fields(Self &self, F &&f) {
+    f(self.form);
+    f(self.window);
+    f(self.h);
+    f(self.x);
+    f(self.table);
+  }
+
+private:
+  Form form = Divided;
+  int window = 1;
+  double h = 1;
+  std::vector<double> x, table;
+};
+
+template <class F, std::size_t... I>
+constexpr void unroll_impl(F &f, std::index_sequence<I...>) {
+  (f(std::integral_constant<std::size_t, I>()), ...);
+}
+
+/**
+ * @brief Calls f(std::integral_constant<std::size_t, I>()) for I = 0..N-1,
+ * fully unrolled.
+ */
+template <std::size_t N, class F> constexpr void unroll(F &&f) {
+  unroll_impl(f, std::make_index_sequence<N>());
+}
+
+/**
+ * @brief Table of k! for k = 0..N-1.
+ */
+template <std::size_t N> constexpr std::array<double, N> factorial_table() {
+  std::array<double, N> f{};
+  double value = 1;
+  for (std::size_t k = 0; k < N; k++) {
+    f[k] = value;
+    value *= static_cast<double>(k + 1);
+  }
+  return f;
+}
+
+/**
+ * @brief Interpolant over exactly N nodes.
+ *
+ * Storage is std::array, the 1/k! factors of the series are folded into the
+ * coefficients from a constexpr factorial table, and every loop over nodes is
+ * unrolled at compile time. Construction and evaluation are constexpr, so a
+ * constant table can be interpolated entirely at compile time.
+ * IntepolationCalculator uses it for the common global sizes it lists in
+ * Interpolant.
+ */
+template <std::size_t N>
+class FixedInterpolant : public InterpolantBase<FixedInterpolant<N>> {
+  static_assert(N >= 2, "FixedInterpolant needs at least two nodes");
+
+public:
+  /// Formula used by the interpolant.
+  enum Form {
+    Barycentric, ///< Lagrange in the second barycentric form.
+    Divided,     ///< Newton divided differences.
+    Forward,     ///< Newton forward differences, equal spacing.
+    Stirling,    ///< Stirling central differences, equal spacing.
+    Bessel       ///< Bessel central differences, equal spacing.
+  };
+
+  constexpr FixedInterpolant() = default;
+
+  /**
+   * @brief Precomputes the coefficients of the given form.
+   * @param form The formula.
+   * @param x The nodes.
+   * @param y The node values.
+   */
+  constexpr FixedInterpolant(Form form, const std::array<double, N> &x,
+                             const std::array<double, N> &y)
+      : form(form), x(x), y(y) {
+    constexpr int n = static_cast<int>(N) - 1;
+    constexpr auto fact = factorial_table<N>();
+    std::array<std::array<double, N>, N> d{};
+    for (std::size_t j = 0; j < N; j++) {
+      d[0][j] = y[j];
+    }
+    for (std::size_t k = 1; k < N; k++) {
+      for (std::size_t j = 0; j + k < N; j++) {
+        d[k][j] = form == Divided ? (d[k - 1][j + 1] - d[k - 1][j]) /
+                                        (x[j + k] - x[j])
+                                  : d[k - 1][j + 1] - d[k - 1][j];
+      }
+    }
+    auto at = [&d](int row, int col) {
+      return row >= 0 && row + col <= n ? d[col][row] : 0.0;
+    };
+
+    h = x[1] - x[0];
+    switch (form) {
+    case Barycentric: {
+      double lo = x[0], hi = x[0];
+      for (double v : x) {
+        lo = v < lo ? v : lo;
+        hi = v > hi ? v : hi;
+      }
+      double scale = hi > lo ? 4.0 / (hi - lo) : 1.0;
+      for (std::size_t i = 0; i < N; i++) {
+        double prod = 1;
+        for (std::size_t j = 0; j < N; j++) {
+          if (i != j) {
+            prod *= (x[i] - x[j]) * scale;
+          }
+        }
+        c[i] = 1 / prod;
+      }
+      break;
+    }
+    case Divided:
+      for (std::size_t k = 0; k < N; k++) {
+        c[k] = d[k][0];
+      }
+      break;
+    case Forward:
+      a = x[0];
+      for (std::size_t k = 0; k < N; k++) {
+        c[k] = d[k][0] / fact[k];
+      }
+      break;
+    case Stirling:
+      a = x[n / 2];
+      for (int k = 0; k <= stirling_order(n); k++) {
+        c[k] = stirling_coefficient(at, n, k) / fact[k];
+      }
+      break;
+    case Bessel:
+      a = x[n / 2];
+      for (int k = 0; k <= n; k++) {
+        c[k] = bessel_coefficient(at, n, k) / fact[k];
+      }
+      break;
+    }
+  }
+
+  /**
+   * @brief Evaluates the interpolant at v; usable in constant expressions.
+   */
+  constexpr double value(double v) const {
+    switch (form) {
+    case Barycentric:
+      return barycentric(v);
+    case Divided:
+      return divided(v);
+    case Forward:
+      return forward((v - a) / h);
+    case Stirling:
+      return stirling((v - a) / h);
+    case Bessel:
+      return bessel((v - a) / h);
+    }
+    return 0;
+  }
+
+  template <int L> void kernel(const double *v, double *out) const {
+    for (int l = 0; l < L; l++) {
+      out[l] = value(v[l]);
+    }
+  }
+
+  template <class Self, class F> static void fields(Self &self, F &&f) {
+    f(self.form);
+    f(self.x);
+    f(self.y);
+    f(self.c);
+    f(self.a);
+    f(self.h);
+  }
+
+private:
+  Form form = Divided;
+  std::array<double, N> x{}, y{};
+  std::array<double, N> c{}; ///< Weights or coefficients with 1/k! folded in.
+  double a = 0, h = 1;
+
+  constexpr double barycentric(double v) const {
+    double num = 0, den = 0;
+    int hit = -1;
+    unroll<N>([&](auto i) {
+      double d = v - x[i];
+      hit = d == 0 ? static_cast<int>(decltype(i)::value) : hit;
+      double w = c[i] / (d == 0 ? 1 : d);
+      num += w * y[i];
+      den += w;
+    });
+    return hit >= 0 ? y[hit] : num / den;
+  }
+
+  constexpr double divided(double v) const {
+    double result = c[N - 1];
+    unroll<N - 1>([&](auto i) {
+      constexpr std::size_t k = N - 2 - decltype(i)::value;
+      result = result * (v - x[k]) + c[k];
+    });
+    return result;
+  }
+
+  constexpr double forward(double t) const {
+    double result = c[0], term = 1;
+    unroll<N - 1>([&](auto i) {
+      constexpr std::size_t k = decltype(i)::value + 1;
+      term *= t - static_cast<double>(k - 1);
+      result += term * c[k];
+    });
+    return result;
+  }
+
+  constexpr double stirling(double t) const {
+    constexpr int order = stirling_order(static_cast<int>(N) - 1);
+    double t2 = t * t, even = 1, odd = t;
+    double result = c[0] + (order > 0 ? t * c[1] : 0);
+    unroll<N>([&](auto i) {
+      constexpr int k = static_cast<int>(decltype(i)::value);
+      if constexpr (k >= 2 && k <= order) {
+        constexpr double s = (k - 1) / 2;
+        double &term = k % 2 == 0 ? even : odd;
+        term *= t2 - s * s;
+        result += term * c[k];
+      }
+    });
+    return result;
+  }
+
+  constexpr double bessel(double t) const {
+    double even = 1, result = c[0];
+    unroll<N - 1>([&](auto i) {
+      constexpr int k = static_cast<int>(decltype(i)::value) + 1;
+      if constexpr (k % 2 == 0) {
+        even *= (t + (k / 2 - 1)) * (t - k / 2);
+        result += even * c[k];
+      } else {
+        result += even * (t - 0.5) * c[k];
+      }
+    });
+    return result;
+  }
+};
+
+/**
+ * @brief Any of the concrete interpolants.
+ *
+ * Interpolants own their precomputed coefficients, are cheap to move and are
+ * safe to evaluate concurrently from several threads.
+ */
+using Interpolant =
+    std::variant<LagrangeInterpolant, NewtonInterpolant,
+                 NewtonFiniteInterpolant, StirlingInterpolant,
+                 BesselInterpolant, WindowedInterpolant, FixedInterpolant<4>,
+                 FixedInterpolant<6>, FixedInterpolant<8>,
+                 FixedInterpolant<16>>;
+
+/**
+ * @brief Evaluates an interpolant at a single point.
+ * @param interpolant The interpolant.
+ * @param v The point.
+ * @return Interpolated value.
+ */
+inline double evaluate(const Interpolant &interpolant, double v) {
+  return std::visit([v](const auto &f) { return f(v); }, interpolant);
+}
+
+/**
+ * @brief Evaluates an interpolant at many points.
+ * @param interpolant The interpolant.
+ * @param queries Pointer to count query points.
+ * @param count Number of query points.
+ * @param out Pointer to count output values.
+ */
+inline void evaluate_many(const Interpolant &interpolant,
+                          const double *queries, std::size_t count,
+                          double *out) {
+  std::visit([&](const auto &f) { f.evaluate_many(queries, count, out); },
+             interpolant);
+}
+
+/**
+ * @brief Evaluates an interpolant at a block of query points in any order.
+ *
+ * A WindowedInterpolant reads a different part of its table for every
+ * query, so its queries are evaluated in ascending order, where neighbouring
+ * queries share their rows and the table is read front to back, and the
+ * results are scattered back to the order of the queries. Other interpolants
+ * use one coefficient set for all queries and are evaluated in place.
+ * @param interpolant The interpolant.
+ * @param queries Pointer to count query points.
+ * @param count Number of query points.
+ * @param out Pointer to count output values.
+ */
+inline void evaluate_batch(const Interpolant &interpolant,
+                           const double *queries, std::size_t count,
+                           double *out) {
+  if (!std::holds_alternative<WindowedInterpolant>(interpolant) ||
+      std::is_sorted(queries, queries + count)) {
+    evaluate_many(interpolant, queries, count, out);
+    return;
+  }
+  std::vector<std::size_t> order(count);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [queries](std::size_t a,
+                                                  std::size_t b) {
+    // NaNs compare equal to each other and greater than everything else.
+    return queries[a] < queries[b] ||
+           (std::isnan(queries[b]) && !std::isnan(queries[a]));
+  });
+  std::vector<double> sorted(count), values(count);
+  for (std::size_t i = 0; i < count; i++) {
+    sorted[i] = queries[order[i]];
+  }
+  evaluate_many(interpolant, sorted.data(), count, values.data());
+  for (std::size_t i = 0; i < count; i++) {
+    out[order[i]] = values[i];
+  }
+}
+
+#endif /* A0EC0C96_7131_4E40_8651_A0B7C9F65982 */
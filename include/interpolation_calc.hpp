@@ -1,13 +1,35 @@
 #ifndef DCD448C5_F0B2_4DE4_A579_7D0F39BFBF30
 #define DCD448C5_F0B2_4DE4_A579_7D0F39BFBF30
 
+#include "difference_table.hpp"
+#include "interpolant.hpp"
+#include "node_set.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
 #include <cmath>
 #include <functional>
+#include <memory>
 #include <numeric>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
+/// Bytes reserved per number of a to_latex() formula, with its "(x - ", ")"
+/// and separator.
+constexpr std::size_t kLatexBytesPerNumber = 20;
+
+/**
+ * @brief Thrown by IntepolationCalculator once its cancellation flag is set.
+ */
+class InterpolationCancelled : public std::runtime_error {
+public:
+  InterpolationCancelled() : std::runtime_error("Interpolation cancelled") {}
+};
+
 /**
  * @brief Class for calculating interpolation using various methods.
  */
@@ -44,247 +66,458 @@ public:
   }
 
 private:
-  InterpolationMethod method; ///< The interpolation method to use.
-  std::vector<double> x, y;   ///< Data points (x, y).
+  InterpolationMethod method;           ///< The interpolation method to use.
+  std::shared_ptr<const NodeSet> nodes; ///< Nodes and shared precomputation.
+  ValueSpan x, y;                       ///< Data points (x, y).
+  int window;                           ///< Local window size, 0 for global.
+  /// If set, the O(n^2) loops stop once it is true, see check_cancelled().
+  std::shared_ptr<const std::atomic<bool>> cancelled;
+  const Interpolant *interpolant; ///< Interpolant held by nodes.
+
+  bool is_cancelled() const {
+    return cancelled && cancelled->load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Throws InterpolationCancelled if the cancellation flag is set.
+   *
+   * Called once per row or order of the quadratic loops, so a cancelled
+   * build or formula stops within O(n) work. A build that throws leaves no
+   * interpolant in the NodeSet.
+   */
+  void check_cancelled() const {
+    if (is_cancelled()) {
+      throw InterpolationCancelled();
+    }
+  }
+
+  /**
+   * @brief Calculates the barycentric weights w_i = 1 / prod_{j != i} (x_i -
+   * x_j).
+   *
+   * The differences are scaled by 4 / (max(x) - min(x)) to keep the products
+   * away from overflow; the barycentric formula is invariant to a common
+   * factor on the weights.
+   * @return Vector of barycentric weights.
+   */
+  std::vector<double> barycentric_weights() const {
+    std::vector<double> w(x.size(), 1.0);
+    if (x.size() < 2) {
+      return w;
+    }
+    auto [lo, hi] = std::minmax_element(x.begin(), x.end());
+    double scale = *hi > *lo ? 4.0 / (*hi - *lo) : 1.0;
+    for (int i = 0; i < static_cast<int>(x.size()); i++) {
+      check_cancelled();
+      double prod = 1;
+      for (int j = 0; j < static_cast<int>(x.size()); j++) {
+        if (i != j) {
+          prod *= (x[i] - x[j]) * scale;
+        }
+      }
+      w[i] = 1 / prod;
+    }
+    return w;
+  }
 
   /**
    * @brief Calculates the differences for interpolation.
+   * @param tail If set, receives the bottom diagonal f[x_i, ..., x_{n-1}].
    * @return Vector of differences.
    */
-  std::vector<double> differences() const {
-    std::vector<double> diff = y;
+  std::vector<double> differences(std::vector<double> *tail = nullptr) const {
+    unsigned threads = auto_thread_count(y.size(), kWavefrontMinRows);
+    if (threads > 1) {
+      return parallel_differences(threads, tail);
+    }
+    std::vector<double> diff = y.to_vector();
+    if (tail) {
+      tail->assign(y.size(), 0);
+      tail->back() = y.back();
+    }
     for (int i = 1; i < y.size(); i++) {
+      check_cancelled();
       for (int j = static_cast<int>(y.size()) - 1; j >= i; j--) {
         diff[j] = (diff[j] - diff[j - 1]) / (x[j] - x[j - i]);
       }
+      if (tail) {
+        (*tail)[y.size() - 1 - i] = diff.back();
+      }
     }
     return diff;
   }
 
   /**
-   * @brief Calculates the Lagrange interpolation function.
-   * @return Lagrange interpolation function.
+   * @brief Calculates the same differences as differences() on several
+   * threads.
+   *
+   * Runs wavefront_sweep() over the divided-difference table with node
+   * j = n - 1 - r in row r, keeping only the kWavefrontBand + 1 most recent
+   * orders in a ring of buffers. Every entry uses the serial expression, so
+   * the result is bit-identical.
+   * @param threads Number of threads.
+   * @param tail If set, receives the bottom diagonal f[x_i, ..., x_{n-1}].
+   * @return Vector of differences.
    */
-  std::function<double(double)> lagrange() const {
-    return [this](double v) {
-      double sum = 0;
-      for (int i = 0; i < y.size(); i++) {
-        double prod = 1;
-        for (int j = 0; j < y.size(); j++) {
-          if (i != j) {
-            prod *= (v - x[j]) / (x[i] - x[j]);
-          }
-        }
-        sum += y[i] * prod;
+  std::vector<double> parallel_differences(unsigned threads,
+                                           std::vector<double> *tail) const {
+    std::size_t n = y.size();
+    std::vector<std::vector<double>> ring(kWavefrontBand + 1,
+                                          std::vector<double>(n));
+    ring[0] = y.to_vector();
+    std::vector<double> diff(n);
+    diff[0] = y[0];
+    if (tail) {
+      tail->assign(n, 0);
+      tail->back() = y.back();
+    }
+
+    wavefront_sweep(n, threads, [&](std::size_t i, std::size_t begin,
+                                    std::size_t end) {
+      if (is_cancelled()) {
+        return; // Skips the rest cheaply; thrown below, on this thread.
+      }
+      const std::vector<double> &prev = ring[(i - 1) % ring.size()];
+      std::vector<double> &cur = ring[i % ring.size()];
+      for (std::size_t r = begin; r < end; r++) {
+        std::size_t j = n - 1 - r;
+        cur[j] = (prev[j] - prev[j - 1]) / (x[j] - x[j - i]);
+      }
+      if (end == n - i) {
+        diff[i] = cur[i];
       }
-      return sum;
-    };
+      if (begin == 0 && tail) {
+        (*tail)[n - 1 - i] = cur[n - 1];
+      }
+    });
+    check_cancelled();
+    return diff;
   }
 
   /**
-   * @brief Calculates the Newton (separated) interpolation function.
-   * @return Newton (separated) interpolation function.
+   * @brief Walks the forward-difference table order by order in O(n) memory.
+   *
+   * Each order overwrites the previous one in a single buffer, so only the
+   * entries a method actually needs have to be copied out.
+   * @param visit Called as visit(k, d) for k = 0..n-1, where d[j] holds the
+   * difference of order k at node j for j < n - k.
    */
-  std::function<double(double)> newton_separated() const {
-    std::vector<double> diff = differences();
-
-    return [this, diff](double v) {
-      double sum = diff.front();
-      for (int i = 1; i < x.size(); i++) {
-        double prod = 1;
-        for (int j = 0; j < i; j++) {
-          prod *= (v - x[j]);
-        }
-
-        sum += diff[i] * prod;
+  template <class Visit> void forward_sweep(Visit visit) const {
+    std::vector<double> d = y.to_vector();
+    visit(0, static_cast<const std::vector<double> &>(d));
+    for (int k = 1; k < static_cast<int>(d.size()); k++) {
+      check_cancelled();
+      for (int j = 0; j + k < static_cast<int>(d.size()); j++) {
+        d[j] = d[j + 1] - d[j];
       }
-      return sum;
-    };
+      visit(k, static_cast<const std::vector<double> &>(d));
+    }
   }
 
   /**
-   * @brief Calculates the Newton (finite differences) interpolation function.
-   * @return Newton (finite differences) interpolation function.
+   * @brief Calculates the forward differences of y_0.
+   * @param tail If set, receives the bottom diagonal: the difference of order
+   * k at node n - 1 - k.
+   * @return Vector of forward differences of y_0 of order 0..n-1.
    */
-  std::function<double(double)> newton_finite() const {
-    int n = x.size() - 1;
-    std::vector<std::vector<double>> defy = difference_table();
-
-    return [this, n, defy](double v) {
-      double result = defy.front().front();
-      double term = 1;
-
-      for (int i = 1; i <= n; i++) {
-        term *= v - x[i - 1];
-        result += term * defy.front()[i] / factorial(i);
+  std::vector<double>
+  forward_differences(std::vector<double> *tail = nullptr) const {
+    int n = static_cast<int>(y.size());
+    std::vector<double> top(n);
+    if (tail) {
+      tail->resize(n);
+    }
+    forward_sweep([&](int k, const std::vector<double> &d) {
+      top[k] = d[0];
+      if (tail) {
+        (*tail)[k] = d[n - 1 - k];
       }
-
-      return result;
-    };
+    });
+    return top;
   }
 
   /**
-   * @brief Calculates the Stirling interpolation function.
-   * @return Stirling interpolation function.
+   * @brief Collects the central differences of the Stirling or Bessel formula
+   * into one coefficient per order k.
+   *
+   * Where a formula averages two differences of the same order, the average is
+   * stored, so evaluation only multiplies it by the t-polynomial of order k.
+   * @return Vector of central-difference coefficients.
    */
-  std::function<double(double)> stirling() const {
-    int n = x.size() - 1;
-    int center = n / 2;
-    double a = x[center];
-    std::vector<std::vector<double>> defy = difference_table();
-
-    return [this, n, center, a, defy](double v) {
-      double h = x[center + 1] - x[center];
-      double t = (v - a) / h;
-
-      double result = defy[center].front() +
-                      t * (defy[center - 1][1] + defy[center][1]) / 2 +
-                      std::pow(t, 2) / 2 * defy[center - 1][2];
-      double term = std::pow(t, 2) / 2;
-
-      for (int k = 3; k < n; k++) {
-        if (k % 2 == 0) {
-          term *= t / k;
-          result += term * defy[center - k / 2][k];
-        } else {
-          term *= (std::pow(t, 2) - std::pow(k / 2, 2)) / (k * t);
-          result += term *
-                    (defy[center - k / 2 - 1][k] + defy[center - k / 2][k]) / 2;
-        }
+  std::vector<double> central_coefficients() const {
+    int n = static_cast<int>(x.size()) - 1;
+    int order = method == Stirling ? stirling_order(n) : n;
+    std::vector<double> c(order + 1);
+    forward_sweep([&](int k, const std::vector<double> &d) {
+      if (k > order) {
+        return;
       }
-
-      return result;
-    };
+      auto at = [&d, n](int row, int col) {
+        return row >= 0 && row + col <= n ? d[row] : 0.0;
+      };
+      c[k] = method == Stirling ? stirling_coefficient(at, n, k)
+                                : bessel_coefficient(at, n, k);
+    });
+    return c;
   }
 
   /**
-   * @brief Calculates the Bessel interpolation function.
-   * @return Bessel interpolation function.
+   * @brief Builds the windowed interpolant over the nodes sorted by x.
+   *
+   * Only differences of order below the window size are kept, one row of
+   * `window` entries per node. Lagrange and Newton (separated) use divided
+   * differences, which give the same local polynomial; the other methods use
+   * forward differences and assume equally spaced nodes.
+   * @return Windowed interpolant.
    */
-  std::function<double(double)> bessel() const {
-    int n = x.size() - 1;
-    int center = n / 2;
-    double a = x[center];
-
-    std::vector<std::vector<double>> defy = difference_table();
-
-    return [this, n, center, a, defy](double v) {
-      double h = x[center + 1] - x[center];
-      double t = (v - a) / h;
-      double result =
-          (defy[center].front() + defy[center + 1].front()) / 2 +
-          (t - 0.5) * defy[center][1] +
-          t * (t - 1) / 2 * (defy[center - 1][2] + defy[center][2]) / 2;
-      double term = t * (t - 1) / 2;
-
-      for (int k = 3; k <= n; k++) {
-        if (k % 2 == 0) {
-          term /= t - 0.5;
-          term *= (t + ((k / 2.0 - 1))) * (t - (k / 2.0)) / k;
-          result += term *
-                    (defy[center - 1 - (k / 2 - 1)][k] +
-                     defy[center - (k / 2 - 1)][k]) /
-                    2;
-        } else {
-          term *= (t - 0.5) / k;
-          result += term * defy[center - k / 2][k];
-        }
-      }
-
-      return result;
-    };
-  }
-
-  std::string lagrange_latex() const {
-    std::vector<std::string> terms;
+  WindowedInterpolant windowed() const {
+    int n = static_cast<int>(x.size());
+    int k = window;
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [this](int a, int b) { return x[a] < x[b]; });
+
+    std::vector<double> xs(n);
+    std::vector<double> table(static_cast<std::size_t>(n) * k, 0);
+    for (int j = 0; j < n; j++) {
+      xs[j] = x[order[j]];
+      table[static_cast<std::size_t>(j) * k] = y[order[j]];
+    }
 
-    for (int i = 0; i < this->x.size(); i++) {
-      std::vector<std::string> term_parts;
-      for (int j = 0; j < this->x.size(); j++) {
-        if (i != j) {
-          term_parts.push_back("(x - " + std::to_string(x[j]) + ")");
+    bool divided = method == Lagrange || method == NewtonSeparated;
+    for (int m = 1; m < k; m++) {
+      check_cancelled();
+      for (int j = 0; j + m < n; j++) {
+        double *d = &table[static_cast<std::size_t>(j) * k + m];
+        *d = d[k - 1] - d[-1];
+        if (divided) {
+          *d /= xs[j + m] - xs[j];
         }
       }
+    }
 
-      std::string term;
-      if (!term_parts.empty()) {
-        term =
-            std::to_string(y[i]) + " * " +
-            std::accumulate(term_parts.begin(), term_parts.end(), std::string(),
-                            [](const std::string &a, const std::string &b) {
-                              return a.empty() ? b : a + " * " + b;
-                            });
-      } else {
-        term = std::to_string(y[i]);
-      }
+    WindowedInterpolant::Form form = WindowedInterpolant::Divided;
+    if (method == NewtonFinite) {
+      form = WindowedInterpolant::Forward;
+    } else if (method == Stirling) {
+      form = WindowedInterpolant::Stirling;
+    } else if (method == Bessel) {
+      form = WindowedInterpolant::Bessel;
+    }
+    return WindowedInterpolant(form, k, std::move(xs), std::move(table));
+  }
 
-      terms.push_back(term);
+  /**
+   * @brief Builds the fixed-size interpolant of the chosen method, which must
+   * be Lagrange, Stirling or Bessel.
+   * @return Interpolant over exactly N nodes.
+   */
+  template <std::size_t N> FixedInterpolant<N> fixed() const {
+    using Fixed = FixedInterpolant<N>;
+    typename Fixed::Form form;
+    switch (method) {
+    case Lagrange:
+      form = Fixed::Barycentric;
+      break;
+    case Stirling:
+      form = Fixed::Stirling;
+      break;
+    case Bessel:
+      form = Fixed::Bessel;
+      break;
+    default:
+      throw std::invalid_argument("Unknown interpolation method");
     }
+    std::array<double, N> fx, fy;
+    std::copy(x.begin(), x.end(), fx.begin());
+    std::copy(y.begin(), y.end(), fy.begin());
+    return Fixed(form, fx, fy);
+  }
 
-    return std::accumulate(terms.begin(), terms.end(), std::string(),
-                           [](const std::string &a, const std::string &b) {
-                             return a.empty() ? b : a + " + " + b;
-                           });
+  /**
+   * @brief Builds the global Newton polynomial over divided differences.
+   */
+  NewtonInterpolant newton() const {
+    std::vector<double> tail;
+    std::vector<double> diff = differences(&tail);
+    return NewtonInterpolant(x.to_vector(), std::move(diff), std::move(tail));
   }
-  std::string newton_separated_latex() const {
-    std::vector<double> diff(y);
-    for (int i = 1; i < static_cast<int>(y.size()); i++) {
-      for (int j = static_cast<int>(y.size()) - 1; j >= i; j--) {
-        diff[j] = (diff[j] - diff[j - 1]) / (x[j] - x[j - i]);
+
+  /**
+   * @brief Builds the interpolant of the chosen method.
+   *
+   * Global Lagrange, Stirling and Bessel interpolants over 4, 6, 8 or 16
+   * nodes use the unrolled FixedInterpolant. The Newton methods always give
+   * their own interpolant, so add_node() works for any node count.
+   * Windowed Stirling takes odd windows only and windowed Bessel even ones,
+   * the sizes for which their central differences fit in the window; other
+   * sizes are rejected rather than rounded, so the window asked for is the
+   * one used.
+   * @return Interpolant owning the barycentric weights (Lagrange), divided
+   * differences (Newton separated), forward differences of y_0 (Newton
+   * finite) or central differences (Stirling, Bessel).
+   */
+  Interpolant build() const {
+    INTERP_PROFILE_SCOPE("build");
+    if (x.empty() || x.size() != y.size()) {
+      throw std::invalid_argument("x and y must be non-empty and equal size");
+    }
+    if (window > 0) {
+      if (window > WindowedInterpolant::kMaxWindow) {
+        throw std::invalid_argument("Window is too large");
+      }
+      // Otherwise the top order would need a difference from outside the
+      // window: Stirling would drop it and Bessel halve it.
+      if (method == Stirling && window % 2 == 0) {
+        throw std::invalid_argument("Stirling needs an odd window");
+      }
+      if (method == Bessel && window % 2 != 0) {
+        throw std::invalid_argument("Bessel needs an even window");
       }
+      return windowed();
     }
-
-    std::vector<std::string> terms = {std::to_string(diff[0])};
-
-    for (int i = 1; i < static_cast<int>(x.size()); i++) {
-      std::vector<std::string> term_parts;
-      for (int j = 0; j < i; j++) {
-        term_parts.push_back("(x - " + std::to_string(x[j]) + ")");
+    if (method != NewtonSeparated && method != NewtonFinite) {
+      switch (x.size()) {
+      case 4:
+        return fixed<4>();
+      case 6:
+        return fixed<6>();
+      case 8:
+        return fixed<8>();
+      case 16:
+        return fixed<16>();
       }
-
-      std::string term =
-          std::to_string(diff[i]) + " * " +
-          std::accumulate(term_parts.begin(), term_parts.end(), std::string(),
-                          [](const std::string &a, const std::string &b) {
-                            return a.empty() ? b : a + " * " + b;
-                          });
-      terms.push_back(term);
     }
+    int n = static_cast<int>(x.size()) - 1;
+    int center = n / 2;
+    switch (method) {
+    case Lagrange:
+      return LagrangeInterpolant(x.to_vector(), y.to_vector(),
+                                 barycentric_weights());
+    case NewtonSeparated:
+      return newton();
+    case NewtonFinite: {
+      std::vector<double> tail;
+      std::vector<double> diff = forward_differences(&tail);
+      return NewtonFiniteInterpolant(x.front(), n > 0 ? x[1] - x[0] : 1,
+                                     std::move(diff), std::move(tail));
+    }
+    case Stirling:
+      return StirlingInterpolant(x[center],
+                                 n > 0 ? x[center + 1] - x[center] : 1,
+                                 central_coefficients());
+    case Bessel:
+      return BesselInterpolant(x[center],
+                               n > 0 ? x[center + 1] - x[center] : 1,
+                               central_coefficients());
+    default:
+      throw std::invalid_argument("Unknown interpolation method");
+    }
+  }
 
-    return std::accumulate(terms.begin(), terms.end(), std::string(),
-                           [](const std::string &a, const std::string &b) {
-                             return a.empty() ? b : a + " + " + b;
-                           });
+  /**
+   * @brief Appends value as std::to_string() would, with std::to_chars.
+   */
+  static void append_latex_number(std::string &out, double value) {
+    char buffer[328]; // Enough for -DBL_MAX with 6 decimals.
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value,
+                                std::chars_format::fixed, 6);
+    out.append(buffer, result.ptr);
   }
-  std::string newton_finite_latex() const {
-    std::vector<double> diff(y);
-    for (int i = 1; i < static_cast<int>(y.size()); i++) {
-      for (int j = static_cast<int>(y.size()) - 1; j >= i; j--) {
-        diff[j] = (diff[j] - diff[j - 1]) / (x[j] - x[j - i]);
+
+  /**
+   * @brief Number of items join_latex() writes out of count.
+   */
+  static std::size_t latex_written(std::size_t count, std::size_t keep) {
+    return keep > 0 && count > 2 * keep ? 2 * keep : count;
+  }
+
+  /**
+   * @brief Writes item(0), ..., item(count - 1) joined by separator.
+   * @param keep If nonzero and count > 2 keep, only the first and last keep
+   * items are written, with "\ldots" in place of the others.
+   */
+  template <class Item>
+  static void join_latex(std::string &out, std::size_t count,
+                         std::size_t keep, const char *separator, Item item) {
+    for (std::size_t i = 0; i < count; i++) {
+      if (i > 0) {
+        out += separator;
       }
+      if (i == keep && latex_written(count, keep) < count) {
+        out += "\\ldots";
+        out += separator;
+        i = count - keep;
+      }
+      item(i);
     }
+  }
 
-    std::vector<std::string> terms = {std::to_string(diff[0])};
+  std::string lagrange_latex(std::size_t keep) const {
+    std::size_t n = x.size();
+    std::size_t numbers =
+        latex_written(n, keep) * (1 + latex_written(n - 1, keep));
+    std::string out;
+    out.reserve(numbers * kLatexBytesPerNumber);
+    join_latex(out, n, keep, " + ", [&](std::size_t i) {
+      check_cancelled();
+      append_latex_number(out, y[i]);
+      if (n > 1) {
+        out += " * ";
+      }
+      join_latex(out, n - 1, keep, " * ", [&](std::size_t k) {
+        out += "(x - ";
+        append_latex_number(out, x[k < i ? k : k + 1]);
+        out += ')';
+      });
+    });
+    return out;
+  }
 
-    for (int i = 1; i < static_cast<int>(x.size()); i++) {
-      std::vector<std::string> term_parts;
-      for (int j = 0; j < i; j++) {
-        term_parts.push_back("(x - " + std::to_string(x[j]) + ")");
+  /**
+   * @brief Writes the Newton form with coefficients diff, shared by both
+   * Newton methods.
+   */
+  std::string newton_latex(const std::vector<double> &diff,
+                           std::size_t keep) const {
+    std::size_t n = x.size();
+    std::size_t numbers =
+        latex_written(n, keep) * (1 + latex_written(n - 1, keep));
+    std::string out;
+    out.reserve(numbers * kLatexBytesPerNumber);
+    join_latex(out, n, keep, " + ", [&](std::size_t i) {
+      check_cancelled();
+      append_latex_number(out, diff[i]);
+      if (i > 0) {
+        out += " * ";
       }
+      join_latex(out, i, keep, " * ", [&](std::size_t j) {
+        out += "(x - ";
+        append_latex_number(out, x[j]);
+        out += ')';
+      });
+    });
+    return out;
+  }
 
-      std::string term =
-          std::to_string(diff[i]) + " * " +
-          std::accumulate(term_parts.begin(), term_parts.end(), std::string(),
-                          [](const std::string &a, const std::string &b) {
-                            return a.empty() ? b : a + " * " + b;
-                          });
-      terms.push_back(term);
+  /**
+   * @brief Writes the Newton form of both Newton methods from the divided
+   * differences of the global NewtonSeparated interpolant, which the NodeSet
+   * builds once for all calculators and formulas.
+   */
+  std::string newton_separated_latex(std::size_t keep) const {
+    const Interpolant &global = nodes->interpolant(
+        NewtonSeparated, 0, [this]() -> Interpolant { return newton(); });
+    const auto *f = std::get_if<NewtonInterpolant>(&global);
+    if (!f) {
+      // The slot is only ever filled by newton() or a validated snapshot.
+      throw std::logic_error("Global Newton slot holds another interpolant");
     }
-
-    return std::accumulate(terms.begin(), terms.end(), std::string(),
-                           [](const std::string &a, const std::string &b) {
-                             return a.empty() ? b : a + " + " + b;
-                           });
+    return newton_latex(f->coefficients(), keep);
+  }
+  std::string newton_finite_latex(std::size_t keep) const {
+    return newton_separated_latex(keep);
   }
 
 public:
@@ -292,32 +525,49 @@ public:
    * @brief Calculates the difference table for interpolation.
    * @return Difference table.
    */
-  std::vector<std::vector<double>> difference_table() const {
-    std::vector<std::vector<double>> defy(y.size(),
-                                          std::vector<double>(y.size(), 0));
-
-    for (int i = 0; i < y.size(); i++) {
-      defy[i][0] = y[i];
-    }
-
-    for (int i = 1; i < y.size(); i++) {
-      for (int j = 0; j < y.size() - 1; j++) {
-        defy[i][j] = defy[j + 1][i - 1] - defy[j][i - 1];
-      }
-    }
-
-    return defy;
+  const DifferenceTable &difference_table() const {
+    return nodes->difference_table();
   }
   /**
    * @brief Constructs an InterpolationCalculator object.
    * @param method The interpolation method to use.
    * @param x The x-coordinates of the data points.
    * @param y The y-coordinates of the data points.
+   * @param window If positive and smaller than the node count, interpolate
+   * locally over this many nodes around each query instead of building one
+   * global polynomial; odd for Stirling, even for Bessel.
+   * @param cancelled If set, building and to_latex() throw
+   * InterpolationCancelled soon after it becomes true.
    */
-  IntepolationCalculator(InterpolationMethod method,
-                         const std::vector<double> &x,
-                         const std::vector<double> &y)
-      : method(method), x(x), y(y) {}
+  IntepolationCalculator(
+      InterpolationMethod method, const std::vector<double> &x,
+      const std::vector<double> &y, int window = 0,
+      std::shared_ptr<const std::atomic<bool>> cancelled = nullptr)
+      : IntepolationCalculator(method, std::make_shared<const NodeSet>(x, y),
+                               window, std::move(cancelled)) {}
+
+  /**
+   * @brief Constructs an InterpolationCalculator over shared nodes.
+   *
+   * The interpolant and difference table are taken from the NodeSet if an
+   * earlier calculator already built them, and stored there otherwise.
+   * @param method The interpolation method to use.
+   * @param nodes The nodes, typically from a NodeSetCache.
+   * @param window As for the other constructor.
+   * @param cancelled As for the other constructor.
+   */
+  IntepolationCalculator(
+      InterpolationMethod method, std::shared_ptr<const NodeSet> nodes,
+      int window = 0,
+      std::shared_ptr<const std::atomic<bool>> cancelled = nullptr)
+      : method(method), nodes(std::move(nodes)), x(this->nodes->x()),
+        y(this->nodes->y()),
+        // Any other window is the global polynomial; normalized so that all
+        // of them share its slot instead of each building its own copy.
+        window(window > 0 && window < static_cast<int>(x.size()) ? window : 0),
+        cancelled(std::move(cancelled)),
+        interpolant(&this->nodes->interpolant(method, this->window,
+                                              [this] { return build(); })) {}
 
   /**
    * @brief Gets the data points used for interpolation.
@@ -331,35 +581,75 @@ public:
     return result;
   }
 
+  /**
+   * @brief Gets the interpolant built for the chosen method.
+   *
+   * The interpolant is held by the NodeSet, which the returned pointer keeps
+   * alive, so it stays valid after the calculator is destroyed; evaluate it
+   * with evaluate() / evaluate_many(). It is shared and cannot change; to
+   * add nodes, copy it and call add_node() on the NewtonInterpolant or
+   * NewtonFiniteInterpolant alternative of the copy.
+   * @return The interpolant, sharing ownership of the NodeSet.
+   */
+  std::shared_ptr<const Interpolant> get_interpolant() const {
+    return std::shared_ptr<const Interpolant>(nodes, interpolant);
+  }
+
+  InterpolationMethod get_method() const { return method; }
+  /// The window in use: 0 for a global polynomial, whatever was passed.
+  int get_window() const { return window; }
+
+  /**
+   * @brief Gets the shared nodes together with everything built from them.
+   */
+  const std::shared_ptr<const NodeSet> &get_node_set() const { return nodes; }
+
   /**
    * @brief Interpolates the function.
-   * @return Interpolated function.
+   * @return Interpolated function holding a copy of the interpolant.
    */
   std::function<double(double)> interpolate() const {
-    switch (method) {
-    case IntepolationCalculator::InterpolationMethod::Lagrange:
-      return lagrange();
-    case IntepolationCalculator::InterpolationMethod::NewtonFinite:
-      return newton_finite();
-    case IntepolationCalculator::InterpolationMethod::NewtonSeparated:
-      return newton_separated();
-    case IntepolationCalculator::InterpolationMethod::Stirling:
-      return stirling();
-    case IntepolationCalculator::InterpolationMethod::Bessel:
-      return bessel();
-    default:
-      throw std::invalid_argument("Unknown interpolation method");
-    }
+    return [f = *interpolant](double v) { return evaluate(f, v); };
+  }
+
+  /**
+   * @brief Evaluates the interpolated function at many points at once.
+   *
+   * Queries are processed in blocks of InterpolantBase::kBatchLanes so that
+   * the inner loops of each kernel run across independent queries and can be
+   * vectorised by the compiler (AVX2/AVX-512 with INTERP_NATIVE_ARCH, SSE2 or
+   * scalar otherwise). Windowed interpolants evaluate the queries in sorted
+   * order, see evaluate_batch(); the results keep the order of the queries.
+   * @param queries Pointer to count query points.
+   * @param count Number of query points.
+   * @param out Pointer to count output values.
+   */
+  void interpolate_many(const double *queries, std::size_t count,
+                        double *out) const {
+    INTERP_PROFILE_SCOPE("evaluate");
+    INTERP_PROFILE_COUNT("evaluate.queries", count);
+    evaluate_batch(*interpolant, queries, count, out);
   }
 
-  std::string to_latex() const {
+  /**
+   * @brief Writes the interpolating polynomial as a formula.
+   *
+   * The formula is written into one buffer reserved up front, so the time is
+   * linear in its length; the length itself grows as n^2 with the node count.
+   * @param keep If nonzero, sums and products of more than 2 keep terms are
+   * summarized by their first and last keep terms around "\ldots", which
+   * bounds the formula to about (2 keep)^2 numbers.
+   * @return The formula, or "Unknown" for methods without one.
+   */
+  std::string to_latex(std::size_t keep = 0) const {
+    INTERP_PROFILE_SCOPE("to_latex");
     switch (method) {
     case IntepolationCalculator::InterpolationMethod::Lagrange:
-      return this->lagrange_latex();
+      return this->lagrange_latex(keep);
     case IntepolationCalculator::InterpolationMethod::NewtonSeparated:
-      return this->newton_separated_latex();
+      return this->newton_separated_latex(keep);
     case IntepolationCalculator::InterpolationMethod::NewtonFinite:
-      return this->newton_finite_latex();
+      return this->newton_finite_latex(keep);
     default:
       return "Unknown";
     }
@@ -1,16 +1,41 @@
 #ifndef FE96EFC8_016F_4D7C_8140_8879DA85361A
 #define FE96EFC8_016F_4D7C_8140_8879DA85361A
 
+#include "interpolation_calc.hpp"
+#include "node_set.hpp"
 #include "table_event_handler.hpp"
 #include "ui_mainwindow.hpp"
 #include <QDateTime>
 #include <QDebug>
 #include <QFileDialog>
+#include <QFutureWatcher>
 #include <QMessageBox>
+#include <QTextBrowser>
 #include <QToolTip>
 #include <QtCharts/QChart>
 #include <QtCharts/QChartView>
 #include <QtCharts/QLineSeries>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief What one method of a run shows in the results panel, computed on a
+ * worker thread.
+ */
+struct MethodResult {
+  IntepolationCalculator::InterpolationMethod method =
+      IntepolationCalculator::Lagrange;
+  /// Renders the rest of the section on demand, see render_section().
+  std::shared_ptr<const IntepolationCalculator> calculator;
+  std::vector<double> values; ///< At the query points of the run.
+  std::string latex;          ///< The formula, summarized if long.
+  std::vector<std::pair<double, double>> nodes; ///< Newton separated only.
+  std::string chart_latex; ///< Newton separated with few nodes only.
+  std::string error;       ///< Set instead of the above if the method failed.
+};
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -28,12 +53,55 @@ public:
 private:
   std::unique_ptr<Ui::MainWindow> ui = std::make_unique<Ui::MainWindow>();
   std::unique_ptr<TableEventHandler> table_event_handler;
+  NodeSetCache node_cache; ///< Precomputation shared across methods and runs.
+  /// Set to cancel the run in progress; null when no run is in progress.
+  std::shared_ptr<std::atomic<bool>> run_cancelled;
+  std::function<void()> run_finished; ///< Called when the run completes.
+  int pending_methods = 0;            ///< Methods of the run not shown yet.
+
+  /**
+   * @brief One page of results_box: the values are shown when the method
+   * finishes, the rest when the page is first opened.
+   */
+  struct ResultSection {
+    MethodResult result;
+    QWidget *page;      ///< Holds view, then the table of render_section().
+    QTextBrowser *view; ///< Values and formula.
+    bool rendered;
+  };
+  std::vector<ResultSection> sections; ///< In the order of results_box.
+
+  /**
+   * @brief Computes all methods over node_set on the worker pool, showing
+   * each as soon as it is done; cancels the run in progress first.
+   * @param node_set The nodes.
+   * @param queries The points to evaluate each method at.
+   * @param finished Called on the GUI thread once all methods are shown.
+   */
+  void start_run(std::shared_ptr<const NodeSet> node_set,
+                 std::vector<double> queries,
+                 std::function<void()> finished = nullptr);
+  /// Cancels the run in progress; its results are discarded. Returns false
+  /// if there was none.
+  bool stop_run();
+  void show_result(const MethodResult &result,
+                   const std::vector<double> &queries);
+  void clear_results();
   void draw_chart(const std::vector<std::pair<double, double>>& points, std::string function);
+  /// Shows the stage breakdown of the last run in the status bar; does
+  /// nothing unless built with INTERP_PROFILING.
+  void show_profile();
+  /// Asks for a file and writes the last run to it as JSON or Chrome trace.
+  void export_profile(bool chrome_trace);
 
 private slots:
   void on_calculation_func_btn_clicked();
   void on_calculation_file_btn_clicked();
   void on_calculation_table_btn_clicked();
+  void cancel_run();
+  /// Renders the formula and the node and difference table of a section
+  /// once.
+  void render_section(int index);
 
   void on_cosx_rbtn_clicked();
   void on_sinx_rbtn_clicked();
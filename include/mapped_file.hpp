@@ -0,0 +1,129 @@
+#ifndef E2887E11_598D_4F7F_AB60_5D0EBF036404
+#define E2887E11_598D_4F7F_AB60_5D0EBF036404
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Read-only view of a whole file.
+ *
+ * On POSIX systems the file is memory-mapped, so its pages are loaded on
+ * demand and never copied; elsewhere it is read into memory once.
+ */
+class MappedFile {
+public:
+  MappedFile() = default;
+  explicit MappedFile(const std::string &path) { open(path); }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  MappedFile(MappedFile &&other) noexcept { swap(other); }
+  MappedFile &operator=(MappedFile &&other) noexcept {
+    MappedFile(std::move(other)).swap(*this);
+    return *this;
+  }
+
+  ~MappedFile() { close(); }
+
+  /**
+   * @brief Maps the file, replacing the current one.
+   * @param path Path to the file.
+   * @return True on success.
+   */
+  bool open(const std::string &path) {
+    close();
+#ifdef _WIN32
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+      return false;
+    }
+    buffer.assign(std::istreambuf_iterator<char>(file),
+                  std::istreambuf_iterator<char>());
+    data_ = buffer.data();
+    size_ = buffer.size();
+    is_open_ = true;
+    return true;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      return false;
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ > 0) {
+      void *p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED) {
+        ::close(fd);
+        size_ = 0;
+        return false;
+      }
+      ::madvise(p, size_, MADV_SEQUENTIAL);
+      data_ = static_cast<const char *>(p);
+    }
+    ::close(fd);
+    is_open_ = true;
+    return true;
+#endif
+  }
+
+  /**
+   * @brief Unmaps the file.
+   */
+  void close() {
+#ifdef _WIN32
+    buffer.clear();
+#else
+    if (data_ != nullptr) {
+      ::munmap(const_cast<char *>(data_), size_);
+    }
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    is_open_ = false;
+  }
+
+  bool is_open() const { return is_open_; }
+  const char *data() const { return data_; }
+  std::size_t size() const { return size_; }
+  const char *begin() const { return data_; }
+  const char *end() const { return data_ + size_; }
+
+  void swap(MappedFile &other) noexcept {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    std::swap(is_open_, other.is_open_);
+#ifdef _WIN32
+    std::swap(buffer, other.buffer);
+    // Both strings keep their heap storage across the swap unless they were
+    // short, so refresh the pointers.
+    data_ = buffer.data();
+    other.data_ = other.buffer.data();
+#endif
+  }
+
+private:
+  const char *data_ = nullptr;
+  std::size_t size_ = 0;
+  bool is_open_ = false;
+#ifdef _WIN32
+  std::string buffer;
+#endif
+};
+
+#endif /* E2887E11_598D_4F7F_AB60_5D0EBF036404 */
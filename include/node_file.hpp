@@ -0,0 +1,217 @@
+#ifndef F7EAE964_D0E1_46BC_B179_F9AAB5D09168
+#define F7EAE964_D0E1_46BC_B179_F9AAB5D09168
+
+#include "file_parser.hpp"
+#include "mapped_file.hpp"
+#include "node_set.hpp"
+#include "profiler.hpp"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// First bytes of every binary node file.
+constexpr char kNodeFileMagic[8] = {'I', 'N', 'T', 'P', 'N', 'O', 'D', 'E'};
+
+/// Current version of the binary node format.
+constexpr std::uint32_t kNodeFileVersion = 1;
+
+/// Alignment of every column in a binary node file, in bytes.
+constexpr std::uint64_t kNodeFileAlign = 64;
+
+/**
+ * @brief Header at the start of a binary node file.
+ *
+ * The header is followed by three float64 columns, each starting at a
+ * multiple of kNodeFileAlign: the query points, the x-coordinates and the
+ * y-coordinates. All fields use the byte order of the writing machine; a file
+ * from a machine of the other order fails the version check.
+ */
+struct NodeFileHeader {
+  char magic[8];             ///< kNodeFileMagic.
+  std::uint32_t version;     ///< kNodeFileVersion.
+  std::uint32_t header_size; ///< sizeof(NodeFileHeader).
+  std::uint64_t node_count;
+  std::uint64_t query_count;
+  std::uint64_t checksum;     ///< NodeSet::hash() of the nodes.
+  std::uint64_t query_offset; ///< Byte offset of the query column.
+  std::uint64_t x_offset;     ///< Byte offset of the x column.
+  std::uint64_t y_offset;     ///< Byte offset of the y column.
+};
+static_assert(sizeof(NodeFileHeader) == 64, "NodeFileHeader must be packed");
+
+/**
+ * @brief Contents of a binary node file, viewed in place.
+ */
+struct NodeFile {
+  bool status = false;
+  std::string error_message;
+  ValueSpan queries, x_values, y_values; ///< Point into the mapping.
+  std::uint64_t checksum = 0;
+  std::shared_ptr<const MappedFile> mapping;
+
+  /**
+   * @brief NodeSet over the mapped columns, without copying them.
+   *
+   * The NodeSet keeps the mapping alive and takes its hash from the header.
+   */
+  std::shared_ptr<const NodeSet> node_set() const {
+    return std::make_shared<const NodeSet>(x_values, y_values, mapping,
+                                           checksum);
+  }
+};
+
+/**
+ * @brief Tells whether a file starts with the binary node magic.
+ * @param filename Path to the file.
+ * @return True for a binary node file.
+ */
+inline bool is_node_file(const std::string &filename) {
+  std::ifstream file(filename, std::ios::binary);
+  char magic[sizeof(kNodeFileMagic)];
+  return file.read(magic, sizeof(magic)) &&
+         std::memcmp(magic, kNodeFileMagic, sizeof(magic)) == 0;
+}
+
+/**
+ * @brief Writes a binary node file.
+ * @param filename Path to the file.
+ * @param queries The query points.
+ * @param x The x-coordinates.
+ * @param y The y-coordinates; must have the size of x.
+ * @return True on success.
+ */
+inline bool write_node_file(const std::string &filename, ValueSpan queries,
+                            ValueSpan x, ValueSpan y) {
+  if (x.size() != y.size()) {
+    return false;
+  }
+  auto align = [](std::uint64_t offset) {
+    return (offset + kNodeFileAlign - 1) / kNodeFileAlign * kNodeFileAlign;
+  };
+  NodeFileHeader header{};
+  std::memcpy(header.magic, kNodeFileMagic, sizeof(header.magic));
+  header.version = kNodeFileVersion;
+  header.header_size = sizeof(NodeFileHeader);
+  header.node_count = x.size();
+  header.query_count = queries.size();
+  header.checksum =
+      hash_values(y.data(), y.size(), hash_values(x.data(), x.size()));
+  header.query_offset = align(sizeof(NodeFileHeader));
+  header.x_offset = align(header.query_offset + queries.size() * 8);
+  header.y_offset = align(header.x_offset + x.size() * 8);
+
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    return false;
+  }
+  std::uint64_t position = 0;
+  auto put = [&](const void *data, std::uint64_t offset, std::uint64_t bytes) {
+    static const char zeros[kNodeFileAlign] = {};
+    file.write(zeros, static_cast<std::streamsize>(offset - position));
+    file.write(static_cast<const char *>(data),
+               static_cast<std::streamsize>(bytes));
+    position = offset + bytes;
+  };
+  put(&header, 0, sizeof(header));
+  put(queries.data(), header.query_offset, queries.size() * 8);
+  put(x.data(), header.x_offset, x.size() * 8);
+  put(y.data(), header.y_offset, y.size() * 8);
+  return static_cast<bool>(file.flush());
+}
+
+/**
+ * @brief Maps a binary node file.
+ *
+ * Only the header is read; the columns are paged in when first used.
+ * @param filename Path to the file.
+ * @param verify Also recompute the checksum, which reads every node.
+ * @return The columns, or status = false with the reason.
+ */
+inline NodeFile load_node_file(const std::string &filename,
+                               bool verify = false) {
+  INTERP_PROFILE_SCOPE("load_node_file");
+  NodeFile result;
+  auto mapping = std::make_shared<MappedFile>(filename);
+  if (!mapping->is_open()) {
+    result.error_message = "Cannot open file";
+    return result;
+  }
+  NodeFileHeader header;
+  if (mapping->size() < sizeof(header)) {
+    result.error_message = "File is too short for a node file header";
+    return result;
+  }
+  std::memcpy(&header, mapping->data(), sizeof(header));
+  if (std::memcmp(header.magic, kNodeFileMagic, sizeof(header.magic)) != 0) {
+    result.error_message = "Not a binary node file";
+    return result;
+  }
+  if (header.version != kNodeFileVersion ||
+      header.header_size != sizeof(NodeFileHeader)) {
+    result.error_message = "Unsupported node file version";
+    return result;
+  }
+
+  auto column = [&](std::uint64_t offset, std::uint64_t count,
+                    ValueSpan &span) {
+    std::uint64_t size = mapping->size();
+    if (offset % kNodeFileAlign != 0 || offset > size ||
+        count > (size - offset) / 8) {
+      return false;
+    }
+    span = ValueSpan(reinterpret_cast<const double *>(mapping->data() + offset),
+                     static_cast<std::size_t>(count));
+    return true;
+  };
+  if (!column(header.query_offset, header.query_count, result.queries) ||
+      !column(header.x_offset, header.node_count, result.x_values) ||
+      !column(header.y_offset, header.node_count, result.y_values)) {
+    result.error_message = "Node file is truncated or corrupt";
+    return result;
+  }
+  if (verify &&
+      hash_values(result.y_values.data(), result.y_values.size(),
+                  hash_values(result.x_values.data(),
+                              result.x_values.size())) != header.checksum) {
+    result.error_message = "Node file checksum mismatch";
+    return result;
+  }
+
+  result.checksum = header.checksum;
+  result.mapping = std::move(mapping);
+  result.status = true;
+  return result;
+}
+
+/**
+ * @brief Converts a text node file, as read by parse_file(), to the binary
+ * format.
+ * @param text_filename Path to the text file.
+ * @param node_filename Path to the binary file to write.
+ * @param error Receives the reason on failure.
+ * @return True on success.
+ */
+inline bool convert_node_file(const std::string &text_filename,
+                              const std::string &node_filename,
+                              std::string &error) {
+  ParsingResult parsed = parse_file(text_filename);
+  if (!parsed.status) {
+    error = parsed.error_line == 0
+                ? parsed.error_message
+                : "line " + std::to_string(parsed.error_line) + ", column " +
+                      std::to_string(parsed.error_column) + ": " +
+                      parsed.error_message;
+    return false;
+  }
+  if (!write_node_file(node_filename, parsed.queries, parsed.x_values,
+                       parsed.y_values)) {
+    error = "Cannot write " + node_filename;
+    return false;
+  }
+  return true;
+}
+
+#endif /* F7EAE964_D0E1_46BC_B179_F9AAB5D09168 */
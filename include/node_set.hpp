@@ -0,0 +1,269 @@
+#ifndef C6D70F72_3EA8_4221_A8F3_ABC29837E319
+#define C6D70F72_3EA8_4221_A8F3_ABC29837E319
+
+#include "difference_table.hpp"
+#include "interpolant.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 64-bit FNV-1a hash of the bit patterns of a range of doubles.
+ * @param data Pointer to count values.
+ * @param count Number of values.
+ * @param seed Hash to continue from.
+ * @return Hash value.
+ */
+inline std::uint64_t hash_values(const double *data, std::size_t count,
+                                 std::uint64_t seed = 14695981039346656037ull) {
+  std::uint64_t h = seed;
+  for (std::size_t i = 0; i < count; i++) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &data[i], sizeof(bits));
+    for (int b = 0; b < 8; b++) {
+      h ^= (bits >> (8 * b)) & 0xff;
+      h *= 1099511628211ull;
+    }
+  }
+  return h;
+}
+
+/**
+ * @brief Read-only view of a contiguous range of doubles.
+ */
+class ValueSpan {
+public:
+  ValueSpan() = default;
+  ValueSpan(const double *data, std::size_t size) : data_(data), size_(size) {}
+  ValueSpan(const std::vector<double> &v) : data_(v.data()), size_(v.size()) {}
+
+  const double *data() const { return data_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const double *begin() const { return data_; }
+  const double *end() const { return data_ + size_; }
+  double front() const { return data_[0]; }
+  double back() const { return data_[size_ - 1]; }
+  double operator[](std::size_t i) const { return data_[i]; }
+
+  /// Copy of the values.
+  std::vector<double> to_vector() const { return {begin(), end()}; }
+
+  bool operator==(ValueSpan o) const {
+    return std::equal(begin(), end(), o.begin(), o.end());
+  }
+  bool operator!=(ValueSpan o) const { return !(*this == o); }
+
+private:
+  const double *data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+/**
+ * @brief Nodes of one dataset together with everything precomputed from
+ * them.
+ *
+ * The difference table and the interpolant of each method are built on first
+ * use and then shared by every calculator over the same NodeSet. All members
+ * are safe to call concurrently.
+ */
+class NodeSet {
+public:
+  NodeSet(std::vector<double> x, std::vector<double> y)
+      : x_store(std::move(x)), y_store(std::move(y)), x_(x_store),
+        y_(y_store) {
+    key = hash_values(y_.data(), y_.size(),
+                      hash_values(x_.data(), x_.size()));
+  }
+
+  /**
+   * @brief Nodes in memory owned by someone else, such as a mapped node file.
+   * @param x The x-coordinates.
+   * @param y The y-coordinates.
+   * @param owner Kept alive as long as the NodeSet; must keep x and y valid.
+   * @param hash Hash of the nodes as computed by the other constructor, if
+   * already known, so the values need not be read here.
+   */
+  NodeSet(ValueSpan x, ValueSpan y, std::shared_ptr<const void> owner,
+          std::uint64_t hash)
+      : x_(x), y_(y), owner(std::move(owner)), key(hash) {}
+
+  NodeSet(ValueSpan x, ValueSpan y, std::shared_ptr<const void> owner)
+      : NodeSet(x, y, std::move(owner),
+                hash_values(y.data(), y.size(),
+                            hash_values(x.data(), x.size()))) {}
+
+  ValueSpan x() const { return x_; }
+  ValueSpan y() const { return y_; }
+
+  /// Hash of the node coordinates.
+  std::uint64_t hash() const { return key; }
+
+  /**
+   * @brief Forward-difference table of the node values, built once.
+   */
+  const DifferenceTable &difference_table() const {
+    std::call_once(table_once, [this] {
+      INTERP_PROFILE_SCOPE("difference_table");
+      table = DifferenceTable(y_.data(), y_.size());
+      table_ready = true;
+    });
+    return table;
+  }
+
+  /// True once difference_table() has been built or set.
+  bool has_difference_table() const { return table_ready; }
+
+  /**
+   * @brief Installs a difference table built elsewhere, e.g. restored from a
+   * snapshot; ignored if the table already exists.
+   */
+  void set_difference_table(DifferenceTable restored) const {
+    std::call_once(table_once, [&] {
+      table = std::move(restored);
+      table_ready = true;
+    });
+  }
+
+  /**
+   * @brief Interpolant for a method and window size, built once by build().
+   * @param method The interpolation method.
+   * @param window The window size, 0 for a global polynomial.
+   * @param build Returns the Interpolant; called at most once per key.
+   * @return The shared interpolant.
+   */
+  template <class Build>
+  const Interpolant &interpolant(int method, int window, Build build) const {
+    std::shared_ptr<Slot> slot;
+    {
+      std::lock_guard<std::mutex> lock(slots_mutex);
+      auto &entry = slots[{method, window}];
+      if (!entry) {
+        entry = std::make_shared<Slot>();
+      }
+      slot = entry;
+    }
+    std::call_once(slot->once, [&] {
+      slot->value = build();
+      slot->ready = true;
+    });
+    return slot->value;
+  }
+
+  /**
+   * @brief Calls f(method, window, interpolant) for every interpolant built
+   * so far.
+   */
+  template <class F> void for_each_interpolant(F f) const {
+    std::vector<std::pair<std::pair<int, int>, std::shared_ptr<Slot>>> built;
+    {
+      std::lock_guard<std::mutex> lock(slots_mutex);
+      for (const auto &entry : slots) {
+        if (entry.second->ready) {
+          built.emplace_back(entry);
+        }
+      }
+    }
+    for (const auto &[key, slot] : built) {
+      f(key.first, key.second, slot->value);
+    }
+  }
+
+private:
+  struct Slot {
+    std::once_flag once;
+    Interpolant value;
+    std::atomic<bool> ready{false};
+  };
+
+  std::vector<double> x_store, y_store;
+  ValueSpan x_, y_;
+  std::shared_ptr<const void> owner;
+  std::uint64_t key;
+  mutable std::once_flag table_once;
+  mutable DifferenceTable table;
+  mutable std::atomic<bool> table_ready{false};
+  mutable std::mutex slots_mutex;
+  mutable std::map<std::pair<int, int>, std::shared_ptr<Slot>> slots;
+};
+
+/**
+ * @brief Bounded cache of NodeSets keyed by the hash of their nodes.
+ *
+ * Repeated requests for identical nodes return the same NodeSet, so its
+ * precomputed data is reused; the least recently used entries are dropped
+ * beyond the capacity.
+ */
+class NodeSetCache {
+public:
+  explicit NodeSetCache(std::size_t capacity = 8) : capacity(capacity) {}
+
+  /**
+   * @brief Returns the NodeSet for the given nodes, creating it if needed.
+   * @param x The x-coordinates.
+   * @param y The y-coordinates.
+   * @return Shared NodeSet.
+   */
+  std::shared_ptr<const NodeSet> get(const std::vector<double> &x,
+                                     const std::vector<double> &y) {
+    return find_or_insert(
+        hash_values(y.data(), y.size(), hash_values(x.data(), x.size())), x, y,
+        [&] { return std::make_shared<const NodeSet>(x, y); });
+  }
+
+  /**
+   * @brief Same as above, but moves the nodes into a new NodeSet instead of
+   * copying them.
+   */
+  std::shared_ptr<const NodeSet> get(std::vector<double> &&x,
+                                     std::vector<double> &&y) {
+    return find_or_insert(
+        hash_values(y.data(), y.size(), hash_values(x.data(), x.size())), x, y,
+        [&] {
+          return std::make_shared<const NodeSet>(std::move(x), std::move(y));
+        });
+  }
+
+  /**
+   * @brief Returns a cached NodeSet with the same nodes as the given one, or
+   * caches and returns the given one.
+   * @param nodes The candidate, e.g. over a mapped node file.
+   * @return Shared NodeSet.
+   */
+  std::shared_ptr<const NodeSet> get(std::shared_ptr<const NodeSet> nodes) {
+    return find_or_insert(nodes->hash(), nodes->x(), nodes->y(),
+                          [&] { return std::move(nodes); });
+  }
+
+private:
+  template <class Make>
+  std::shared_ptr<const NodeSet> find_or_insert(std::uint64_t key, ValueSpan x,
+                                                ValueSpan y, Make make) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+      if ((*it)->hash() == key && (*it)->x() == x && (*it)->y() == y) {
+        entries.splice(entries.begin(), entries, it);
+        return entries.front();
+      }
+    }
+    entries.push_front(make());
+    if (entries.size() > capacity) {
+      entries.pop_back();
+    }
+    return entries.front();
+  }
+
+  std::size_t capacity;
+  std::mutex mutex;
+  std::list<std::shared_ptr<const NodeSet>> entries;
+};
+
+#endif /* C6D70F72_3EA8_4221_A8F3_ABC29837E319 */
@@ -0,0 +1,199 @@
+#ifndef B7B33CB0_D3A4_419F_9AB1_FBCD8B2A8D1B
+#define B7B33CB0_D3A4_419F_9AB1_FBCD8B2A8D1B
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Reusable barrier for a fixed number of threads.
+ */
+class Barrier {
+public:
+  explicit Barrier(unsigned count) : count(count), waiting(0) {}
+
+  /**
+   * @brief Blocks until all threads have arrived, then resets itself.
+   */
+  void arrive_and_wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    unsigned gen = generation;
+    if (++waiting == count) {
+      waiting = 0;
+      generation++;
+      cv.notify_all();
+    } else {
+      cv.wait(lock, [this, gen] { return gen != generation; });
+    }
+  }
+
+private:
+  std::mutex mutex;
+  std::condition_variable cv;
+  unsigned count, waiting;
+  unsigned generation = 0;
+};
+
+/**
+ * @brief Bounded lock-free queue between one producer and one consumer
+ * thread.
+ * @tparam T Element type.
+ * @tparam Capacity Number of slots, a power of two.
+ */
+template <class T, std::size_t Capacity> class SpscQueue {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+public:
+  /**
+   * @brief Appends a value; called by the producer only.
+   * @return False if the queue is full.
+   */
+  bool try_push(T value) {
+    std::size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    slots[t & (Capacity - 1)] = std::move(value);
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Removes the oldest value; called by the consumer only.
+   * @return False if the queue is empty.
+   */
+  bool try_pop(T &value) {
+    std::size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    value = std::move(slots[h & (Capacity - 1)]);
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Like try_push(), but waits while the queue is full.
+   */
+  void push(T value) {
+    while (!try_push(value)) {
+      std::this_thread::yield();
+    }
+  }
+
+  /**
+   * @brief Like try_pop(), but waits while the queue is empty.
+   */
+  void pop(T &value) {
+    while (!try_pop(value)) {
+      std::this_thread::yield();
+    }
+  }
+
+private:
+  alignas(64) std::atomic<std::size_t> head{0}; ///< Next slot to pop.
+  alignas(64) std::atomic<std::size_t> tail{0}; ///< Next slot to push.
+  T slots[Capacity];
+};
+
+/**
+ * @brief Chooses a thread count so that each thread gets at least
+ * min_per_thread work items.
+ * @param work Number of work items.
+ * @param min_per_thread Smallest worthwhile share of one thread.
+ * @return Thread count between 1 and the hardware concurrency.
+ */
+inline unsigned auto_thread_count(std::size_t work,
+                                  std::size_t min_per_thread) {
+  std::size_t hw = std::max(1u, std::thread::hardware_concurrency());
+  return static_cast<unsigned>(
+      std::clamp<std::size_t>(work / min_per_thread, 1, hw));
+}
+
+/**
+ * @brief Runs f(id) for id = 0..threads-1 on separate threads and waits for
+ * all of them; the calling thread runs id 0.
+ */
+template <class F> void run_parallel(unsigned threads, F f) {
+  std::vector<std::thread> pool;
+  for (unsigned id = 1; id < threads; id++) {
+    pool.emplace_back([&f, id] { f(id); });
+  }
+  f(0);
+  for (auto &t : pool) {
+    t.join();
+  }
+}
+
+/// Number of columns wavefront_sweep() computes between synchronisations.
+constexpr std::size_t kWavefrontBand = 32;
+
+/// Fewest rows per thread for which wavefront_sweep() splits a column.
+constexpr std::size_t kWavefrontMinRows = 4096;
+
+/**
+ * @brief Computes a triangular table column by column, where row r of
+ * column m (0 <= r < n - m) depends on rows r and r + 1 of column m - 1.
+ *
+ * Columns are processed in bands of kWavefrontBand. Within a band each
+ * thread owns a block of rows and computes the trapezoid that depends only
+ * on its own block, so it can run all columns of the band without waiting.
+ * After one barrier every thread fills the small triangle at the right edge
+ * of its block from its neighbour's results, and a second barrier ends the
+ * band. Once a column is too short to split, the rest runs on one thread.
+ * Every entry is computed exactly once by the same expression as in a serial
+ * sweep, so the result is bit-identical.
+ * @param n Number of rows of column 0.
+ * @param threads Number of threads; 1 runs the plain serial sweep.
+ * @param compute Called as compute(m, begin, end) to fill rows [begin, end)
+ * of column m, m >= 1.
+ */
+template <class Compute>
+void wavefront_sweep(std::size_t n, unsigned threads, Compute compute) {
+  if (threads <= 1) {
+    for (std::size_t m = 1; m < n; m++) {
+      compute(m, 0, n - m);
+    }
+    return;
+  }
+
+  Barrier barrier(threads);
+  run_parallel(threads, [&](unsigned id) {
+    for (std::size_t m0 = 1; m0 < n; m0 += kWavefrontBand) {
+      std::size_t rows = n - m0;
+      std::size_t active = std::clamp<std::size_t>(
+          rows / kWavefrontMinRows, 1, threads);
+      if (active == 1) {
+        if (id == 0) {
+          for (std::size_t m = m0; m < n; m++) {
+            compute(m, 0, n - m);
+          }
+        }
+        return;
+      }
+
+      std::size_t band = std::min(kWavefrontBand, n - m0);
+      std::size_t begin = rows * id / active;
+      std::size_t end = rows * (id + 1) / active;
+      if (id < active) {
+        for (std::size_t i = 0; i < band; i++) {
+          compute(m0 + i, begin, end - i);
+        }
+      }
+      barrier.arrive_and_wait();
+      if (id + 1 < active) {
+        for (std::size_t i = 1; i < band; i++) {
+          compute(m0 + i, end - i, end);
+        }
+      }
+      barrier.arrive_and_wait();
+    }
+  });
+}
+
+#endif /* B7B33CB0_D3A4_419F_9AB1_FBCD8B2A8D1B */
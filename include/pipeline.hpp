@@ -0,0 +1,250 @@
+#ifndef A48202BE_F32F_4683_9027_819324633D75
+#define A48202BE_F32F_4683_9027_819324633D75
+
+#include "file_parser.hpp"
+#include "interpolant.hpp"
+#include "mapped_file.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/// Number of nodes the parser hands to the builder at a time.
+constexpr std::size_t kStreamChunk = 4096;
+
+/// Number of node chunks in flight between the parser and the builder.
+constexpr std::size_t kStreamChunks = 8;
+
+struct StreamResult {
+  bool status = false;
+  std::vector<double> queries; ///< The query points, in file order.
+  std::vector<double> values;  ///< The interpolated value at each query.
+  std::size_t node_count = 0;
+  std::size_t answered_after = 0; ///< Nodes read when all values were known.
+  std::size_t error_line = 0;     ///< 1-based line of the error, 0 if none.
+  std::size_t error_column = 0;   ///< 1-based column of the error.
+  std::string error_message;
+};
+
+/**
+ * @brief Parses a node file, builds the interpolant and evaluates the
+ * queries in one overlapping pass.
+ *
+ * One thread parses the memory-mapped file into fixed-size chunks of nodes
+ * and passes them through a bounded lock-free queue to the calling thread,
+ * which consumes each node as soon as it arrives, while parsing continues;
+ * emptied chunks go back through a second queue, so memory use is bounded.
+ *
+ * With window == 0 the nodes extend a NewtonInterpolant by add_node(), and
+ * the queries are evaluated once the last node is in. With a window the nodes
+ * must be in ascending order of x; only the last nodes are kept, and each
+ * query is answered as soon as the window around it, chosen as in
+ * WindowedInterpolant, is complete, so queries near the start of the file
+ * are done long before its end. The result is the same polynomial as the Newton (separated)
+ * IntepolationCalculator over the same nodes and window builds.
+ * @param filename Path to a text node file, as read by parse_file().
+ * @param window Local window size, 0 for one global polynomial.
+ * @return The values at the query points, or status = false with the line,
+ * column and reason of the first error, line 0 if it has no place in the
+ * file, such as a window out of range.
+ */
+inline StreamResult stream_file(const std::string &filename, int window = 0) {
+  INTERP_PROFILE_SCOPE("stream_file");
+  StreamResult result;
+  if (window < 0 || window > WindowedInterpolant::kMaxWindow) {
+    result.error_message =
+        window < 0 ? "Window must not be negative" : "Window is too large";
+    return result;
+  }
+  MappedFile file(filename);
+  if (!file.is_open()) {
+    result.error_message = "Cannot open file";
+    return result;
+  }
+  TextCursor cursor(file.begin(), file.end());
+  if (const char *error = parse_query_line(cursor, result.queries)) {
+    result.error_line = cursor.line();
+    result.error_column = cursor.column();
+    result.error_message = error;
+    return result;
+  }
+
+  struct Chunk {
+    std::size_t count;
+    double x[kStreamChunk], y[kStreamChunk];
+    std::size_t line[kStreamChunk];
+    bool last;
+    const char *error;
+    std::size_t error_line, error_column;
+  };
+  std::vector<Chunk> chunks(kStreamChunks);
+  SpscQueue<Chunk *, kStreamChunks> filled, emptied;
+  for (auto &chunk : chunks) {
+    emptied.try_push(&chunk);
+  }
+  std::atomic<bool> cancelled{false};
+
+  auto parse = [&] {
+    Chunk *chunk;
+    auto take = [&] {
+      emptied.pop(chunk);
+      chunk->count = 0;
+      chunk->last = false;
+      chunk->error = nullptr;
+    };
+    take();
+    for (; !cursor.at_end(); cursor.next_line()) {
+      cursor.skip_blanks();
+      if (cursor.at_line_end()) {
+        continue;
+      }
+      std::size_t i = chunk->count;
+      chunk->line[i] = cursor.line();
+      if (const char *error =
+              parse_node_row(cursor, chunk->x[i], chunk->y[i])) {
+        chunk->error = error;
+        chunk->error_line = cursor.line();
+        chunk->error_column = cursor.column();
+        break;
+      }
+      if (++chunk->count == kStreamChunk) {
+        filled.push(chunk);
+        if (cancelled.load(std::memory_order_relaxed)) {
+          take();
+          break;
+        }
+        take();
+      }
+    }
+    chunk->last = true;
+    filled.push(chunk);
+  };
+
+  auto fail = [&](std::size_t line, std::size_t column, const char *message) {
+    result.error_line = line;
+    result.error_column = column;
+    result.error_message = message;
+    cancelled.store(true, std::memory_order_relaxed);
+  };
+
+  NewtonInterpolant newton;
+  std::vector<double> xs, ys; ///< Most recent nodes, windowed mode only.
+  std::size_t first = 0;      ///< Index of xs[0] among all nodes.
+  std::size_t count = result.queries.size();
+  result.values.resize(count);
+  // Queries in ascending order; those before `located` have the index of the
+  // first node above them in `above`, and those before `answered` are done.
+  std::vector<std::size_t> order(count), above(count);
+  std::size_t located = 0, answered = 0;
+  if (window > 0) {
+    std::iota(order.begin(), order.end(), 0);
+    const std::vector<double> &q = result.queries;
+    std::sort(order.begin(), order.end(), [&q](std::size_t a, std::size_t b) {
+      return q[a] < q[b] || (std::isnan(q[b]) && !std::isnan(q[a]));
+    });
+  }
+  auto answer = [&](std::size_t i, std::size_t start, int k) {
+    double c[WindowedInterpolant::kMaxWindow];
+    const double *nx = &xs[start - first];
+    std::copy_n(&ys[start - first], k, c);
+    for (int m = 1; m < k; m++) {
+      for (int j = k - 1; j >= m; j--) {
+        c[j] = (c[j] - c[j - 1]) / (nx[j] - nx[j - m]);
+      }
+    }
+    newton_series<1>(&result.queries[order[i]], nx, c, 1, 0, k - 1,
+                     &result.values[order[i]]);
+  };
+  auto window_start = [&](std::size_t i) {
+    return above[i] > static_cast<std::size_t>(window / 2)
+               ? above[i] - window / 2
+               : 0;
+  };
+  auto add = [&](double x, double y, std::size_t line) {
+    if (window == 0) {
+      try {
+        newton.add_node(x, y);
+      } catch (const std::invalid_argument &) {
+        fail(line, 1, "Duplicate node");
+      }
+      return;
+    }
+    if (result.node_count > 0 && x <= xs.back()) {
+      fail(line, 1, "Nodes must be in ascending order of x");
+      return;
+    }
+    if (xs.size() == 2 * static_cast<std::size_t>(window)) {
+      xs.erase(xs.begin(), xs.begin() + window);
+      ys.erase(ys.begin(), ys.begin() + window);
+      first += window;
+    }
+    xs.push_back(x);
+    ys.push_back(y);
+    std::size_t n = result.node_count + 1;
+    for (; located < count && x > result.queries[order[located]]; located++) {
+      above[located] = n - 1;
+    }
+    for (; answered < located && n >= window_start(answered) + window;
+         answered++) {
+      answer(answered, window_start(answered), window);
+      result.answered_after = n;
+    }
+  };
+
+  run_parallel(2, [&](unsigned id) {
+    if (id == 1) {
+      parse();
+      return;
+    }
+    for (bool last = false; !last;) {
+      Chunk *chunk;
+      filled.pop(chunk);
+      for (std::size_t i = 0; i < chunk->count && !cancelled; i++) {
+        add(chunk->x[i], chunk->y[i], chunk->line[i]);
+        if (!cancelled) {
+          result.node_count++;
+        }
+      }
+      if (chunk->error != nullptr && !cancelled) {
+        fail(chunk->error_line, chunk->error_column, chunk->error);
+      }
+      last = chunk->last;
+      emptied.push(chunk);
+    }
+  });
+  if (cancelled) {
+    return result;
+  }
+
+  std::size_t n = result.node_count;
+  if (n == 0) {
+    result.error_line = cursor.line();
+    result.error_column = cursor.column();
+    result.error_message = "No nodes";
+    return result;
+  }
+  if (window == 0) {
+    newton.evaluate_many(result.queries.data(), count, result.values.data());
+    result.answered_after = n;
+  } else if (answered < count) {
+    int k = static_cast<int>(std::min<std::size_t>(window, n));
+    for (; answered < count; answered++) {
+      std::size_t idx = answered < located ? above[answered] : n;
+      std::size_t start = std::clamp<std::ptrdiff_t>(
+          static_cast<std::ptrdiff_t>(idx) - window / 2, 0,
+          static_cast<std::ptrdiff_t>(n - k));
+      answer(answered, start, k);
+    }
+    result.answered_after = n;
+  }
+  result.status = true;
+  return result;
+}
+
+#endif /* A48202BE_F32F_4683_9027_819324633D75 */
@@ -0,0 +1,301 @@
+#ifndef E47619E9_0EB7_4A93_B2C4_3D1C77066098
+#define E47619E9_0EB7_4A93_B2C4_3D1C77066098
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Collects stage timings and counters of one run.
+ *
+ * Code is instrumented with INTERP_PROFILE_SCOPE() and INTERP_PROFILE_COUNT(),
+ * which expand to nothing unless INTERP_PROFILING is defined (CMake option
+ * of the same name), so the profiler costs nothing in normal builds. Only
+ * coarse stages are timed: one event is a lock and a vector append.
+ * Stage and counter names must be string literals.
+ */
+class Profiler {
+public:
+  /**
+   * @brief One timed scope.
+   */
+  struct Event {
+    const char *name;
+    std::uint32_t thread;  ///< Small id, in order of first use.
+    std::int64_t start_ns; ///< Since the start of the run.
+    std::int64_t duration_ns;
+  };
+
+  /**
+   * @brief Running total of a counter after one INTERP_PROFILE_COUNT().
+   */
+  struct CounterSample {
+    const char *name;
+    std::uint32_t thread;
+    std::int64_t at_ns;
+    std::int64_t value;
+  };
+
+  /**
+   * @brief Events of one name added up.
+   */
+  struct Stage {
+    const char *name;
+    std::size_t calls;
+    std::int64_t total_ns;
+  };
+
+  /**
+   * @brief The profiler of the process.
+   */
+  static Profiler &instance() {
+    static Profiler profiler;
+    return profiler;
+  }
+
+  /**
+   * @brief Starts a new run, dropping all events and counters.
+   */
+  void reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    events.clear();
+    counter_samples.clear();
+    counters.clear();
+    origin = Clock::now().time_since_epoch().count();
+  }
+
+  /**
+   * @brief Nanoseconds since the start of the run.
+   */
+  std::int64_t now() const {
+    Clock::duration since(Clock::now().time_since_epoch().count() - origin);
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(since).count();
+  }
+
+  /**
+   * @brief Records a scope of the calling thread.
+   */
+  void record(const char *name, std::int64_t start_ns, std::int64_t end_ns) {
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back({name, thread_id(), start_ns, end_ns - start_ns});
+  }
+
+  /**
+   * @brief Adds n to a counter.
+   */
+  void count(const char *name, std::int64_t n) {
+    std::int64_t at = now();
+    std::lock_guard<std::mutex> lock(mutex);
+    std::int64_t &total = counters[name];
+    total += n;
+    counter_samples.push_back({name, thread_id(), at, total});
+  }
+
+  /**
+   * @brief Stages in order of first start, with their total time.
+   */
+  std::vector<Stage> stages() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Event> sorted = events;
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const Event &a, const Event &b) {
+                       return a.start_ns < b.start_ns;
+                     });
+    std::vector<Stage> result;
+    for (const auto &event : sorted) {
+      auto stage =
+          std::find_if(result.begin(), result.end(), [&](const Stage &s) {
+            return std::strcmp(s.name, event.name) == 0;
+          });
+      if (stage == result.end()) {
+        result.push_back({event.name, 0, 0});
+        stage = result.end() - 1;
+      }
+      stage->calls++;
+      stage->total_ns += event.duration_ns;
+    }
+    return result;
+  }
+
+  /**
+   * @brief One-line breakdown of the run for a status bar, e.g.
+   * "12.5 ms: parse_file 8.1, build 3.0, evaluate 0.9".
+   */
+  std::string summary() const {
+    std::string out;
+    append_ms(out, now());
+    out += " ms:";
+    const char *separator = " ";
+    for (const auto &stage : stages()) {
+      out += separator;
+      out += stage.name;
+      out += ' ';
+      append_ms(out, stage.total_ns);
+      separator = ", ";
+    }
+    return out;
+  }
+
+  /**
+   * @brief The run as JSON: per-stage totals, counters and all events.
+   */
+  std::string to_json() const {
+    std::string out = "{\n  \"total_ms\": ";
+    append_ms(out, now());
+    out += ",\n  \"stages\": [";
+    const char *separator = "\n    ";
+    for (const auto &stage : stages()) {
+      out += separator;
+      out += "{\"name\": \"";
+      out += stage.name;
+      out += "\", \"calls\": " + std::to_string(stage.calls) +
+             ", \"total_ms\": ";
+      append_ms(out, stage.total_ns);
+      out += "}";
+      separator = ",\n    ";
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    out += "\n  ],\n  \"counters\": {";
+    separator = "";
+    for (const auto &[name, total] : counters) {
+      out += separator;
+      out += "\"" + std::string(name) + "\": " + std::to_string(total);
+      separator = ", ";
+    }
+    out += "},\n  \"events\": [";
+    separator = "\n    ";
+    for (const auto &event : events) {
+      out += separator;
+      out += "{\"name\": \"";
+      out += event.name;
+      out += "\", \"thread\": " + std::to_string(event.thread) +
+             ", \"start_ms\": ";
+      append_ms(out, event.start_ns);
+      out += ", \"duration_ms\": ";
+      append_ms(out, event.duration_ns);
+      out += "}";
+      separator = ",\n    ";
+    }
+    out += "\n  ]\n}\n";
+    return out;
+  }
+
+  /**
+   * @brief The run in the Chrome trace event format, for chrome://tracing
+   * or Perfetto: complete events for the scopes, counter events for the
+   * counters.
+   */
+  std::string to_chrome_trace() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string out = "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    const char *separator = "\n";
+    for (const auto &event : events) {
+      out += separator;
+      out += "{\"name\": \"";
+      out += event.name;
+      out += "\", \"cat\": \"interp\", \"ph\": \"X\", \"pid\": 1, \"tid\": " +
+             std::to_string(event.thread) + ", \"ts\": ";
+      append_us(out, event.start_ns);
+      out += ", \"dur\": ";
+      append_us(out, event.duration_ns);
+      out += "}";
+      separator = ",\n";
+    }
+    for (const auto &sample : counter_samples) {
+      out += separator;
+      out += "{\"name\": \"";
+      out += sample.name;
+      out += "\", \"cat\": \"interp\", \"ph\": \"C\", \"pid\": 1, \"tid\": " +
+             std::to_string(sample.thread) + ", \"ts\": ";
+      append_us(out, sample.at_ns);
+      out += ", \"args\": {\"value\": " + std::to_string(sample.value) +
+             "}}";
+      separator = ",\n";
+    }
+    out += "\n]}\n";
+    return out;
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  Profiler() : origin(Clock::now().time_since_epoch().count()) {}
+
+  /// Small id of the calling thread; the mutex must be held.
+  std::uint32_t thread_id() {
+    auto id = std::this_thread::get_id();
+    auto it = std::find(threads.begin(), threads.end(), id);
+    if (it == threads.end()) {
+      threads.push_back(id);
+      return static_cast<std::uint32_t>(threads.size() - 1);
+    }
+    return static_cast<std::uint32_t>(it - threads.begin());
+  }
+
+  static void append_ms(std::string &out, std::int64_t ns) {
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), ns / 1e6,
+                                std::chars_format::fixed, 3);
+    out.append(buffer, result.ptr);
+  }
+
+  static void append_us(std::string &out, std::int64_t ns) {
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), ns / 1e3,
+                                std::chars_format::fixed, 3);
+    out.append(buffer, result.ptr);
+  }
+
+  mutable std::mutex mutex;
+  std::atomic<Clock::rep> origin; ///< Start of the run, read without the lock.
+  std::vector<Event> events;
+  std::vector<CounterSample> counter_samples;
+  std::map<std::string, std::int64_t> counters;
+  std::vector<std::thread::id> threads;
+};
+
+/**
+ * @brief Records the lifetime of a scope with the Profiler.
+ */
+class ScopedTimer {
+public:
+  explicit ScopedTimer(const char *name)
+      : name(name), start(Profiler::instance().now()) {}
+  ~ScopedTimer() {
+    Profiler::instance().record(name, start, Profiler::instance().now());
+  }
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+  const char *name;
+  std::int64_t start;
+};
+
+#define INTERP_PROFILE_CONCAT_(a, b) a##b
+#define INTERP_PROFILE_CONCAT(a, b) INTERP_PROFILE_CONCAT_(a, b)
+
+#ifdef INTERP_PROFILING
+/// Starts a new run, see Profiler::reset().
+#define INTERP_PROFILE_BEGIN_RUN() Profiler::instance().reset()
+/// Times the rest of the enclosing scope as stage name.
+#define INTERP_PROFILE_SCOPE(name)                                             \
+  ScopedTimer INTERP_PROFILE_CONCAT(interp_profile_scope_, __LINE__)(name)
+/// Adds n to counter name.
+#define INTERP_PROFILE_COUNT(name, n)                                          \
+  Profiler::instance().count(name, static_cast<std::int64_t>(n))
+#else
+#define INTERP_PROFILE_BEGIN_RUN() static_cast<void>(0)
+#define INTERP_PROFILE_SCOPE(name) static_cast<void>(0)
+#define INTERP_PROFILE_COUNT(name, n) static_cast<void>(0)
+#endif
+
+#endif /* E47619E9_0EB7_4A93_B2C4_3D1C77066098 */
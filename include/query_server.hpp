@@ -0,0 +1,499 @@
+#ifndef FF956B05_2C52_431A_9BDC_6B6B34E074CB
+#define FF956B05_2C52_431A_9BDC_6B6B34E074CB
+
+#include "file_parser.hpp"
+#include "interpolation_calc.hpp"
+#include "node_file.hpp"
+#include "node_set.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/// First field of every request.
+constexpr std::uint32_t kQueryMagic = 0x31515049; // "IPQ1"
+
+/// Most query points in one request; with their values, 32 MiB of buffers.
+constexpr std::uint64_t kQueryMaxQueries = std::uint64_t(1) << 21;
+
+/// Longest path in a QueryLoad request, in bytes.
+constexpr std::uint64_t kQueryMaxPath = 4096;
+
+/// Pause before accepting again when out of file descriptors.
+constexpr std::chrono::milliseconds kQueryAcceptBackoff{50};
+
+#ifdef MSG_NOSIGNAL
+/// Keeps a write to a closed socket from raising SIGPIPE.
+constexpr int kQuerySendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kQuerySendFlags = 0; ///< SO_NOSIGPIPE is set instead.
+#endif
+
+/**
+ * @brief Keeps writes to socket fd from raising SIGPIPE where send() has no
+ * MSG_NOSIGNAL.
+ */
+inline void disable_sigpipe(int fd) {
+#ifdef SO_NOSIGPIPE
+  int on = 1;
+  ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+  static_cast<void>(fd);
+#endif
+}
+
+/**
+ * @brief Request operations.
+ */
+enum QueryOp : std::uint16_t {
+  QueryLoad = 1,     ///< Payload: path of a node file; replies with its table.
+  QueryEvaluate = 2, ///< Payload: count query points; replies with values.
+};
+
+/**
+ * @brief Fixed header of a request, followed by its payload.
+ *
+ * All fields, and the float64 payloads, use the byte order of the host: the
+ * protocol is meant for clients on the same machine.
+ */
+struct QueryRequest {
+  std::uint32_t magic;  ///< kQueryMagic.
+  std::uint16_t op;     ///< QueryOp.
+  std::uint16_t method; ///< IntepolationCalculator::InterpolationMethod.
+  std::uint32_t table;  ///< Table id returned by QueryLoad.
+  std::int32_t window;  ///< Window size, 0 for a global polynomial.
+  std::uint64_t count;  ///< Path length in bytes, or number of queries.
+};
+static_assert(sizeof(QueryRequest) == 24, "QueryRequest must be packed");
+
+/**
+ * @brief Fixed header of a response, followed by count values on success or
+ * count bytes of error message otherwise.
+ */
+struct QueryResponse {
+  std::uint32_t status; ///< 0 on success.
+  std::uint32_t table;  ///< Table id, for QueryLoad.
+  std::uint64_t count;
+};
+static_assert(sizeof(QueryResponse) == 16, "QueryResponse must be packed");
+
+/**
+ * @brief Reads exactly size bytes, retrying after signals.
+ * @return False on end of file or error.
+ */
+inline bool read_full(int fd, void *data, std::size_t size) {
+  char *p = static_cast<char *>(data);
+  while (size > 0) {
+    ssize_t r = ::read(fd, p, size);
+    if (r < 0 && errno == EINTR) {
+      continue;
+    }
+    if (r <= 0) {
+      return false;
+    }
+    p += r;
+    size -= static_cast<std::size_t>(r);
+  }
+  return true;
+}
+
+/**
+ * @brief Writes a header and a payload with as few system calls as possible.
+ *
+ * Sockets are written with kQuerySendFlags, so a peer that disconnects
+ * mid-reply is an error, not SIGPIPE; other descriptors, such as the pipes
+ * of `interp_cli --serve -`, fall back to writev().
+ * @return False on error.
+ */
+inline bool write_full(int fd, const void *header, std::size_t header_size,
+                       const void *payload, std::size_t payload_size) {
+  iovec parts[2] = {{const_cast<void *>(header), header_size},
+                    {const_cast<void *>(payload), payload_size}};
+  iovec *part = parts;
+  int left = payload_size > 0 ? 2 : 1;
+  while (left > 0) {
+    msghdr message{};
+    message.msg_iov = part;
+    message.msg_iovlen = left;
+    ssize_t w = ::sendmsg(fd, &message, kQuerySendFlags);
+    if (w < 0 && errno == ENOTSOCK) {
+      w = ::writev(fd, part, left);
+    }
+    if (w < 0 && errno == EINTR) {
+      continue;
+    }
+    if (w < 0) {
+      return false;
+    }
+    auto written = static_cast<std::size_t>(w);
+    while (left > 0 && written >= part->iov_len) {
+      written -= part->iov_len;
+      part++;
+      left--;
+    }
+    if (left > 0) {
+      part->iov_base = static_cast<char *>(part->iov_base) + written;
+      part->iov_len -= written;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Long-running evaluator that keeps loaded tables and their
+ * interpolants resident.
+ *
+ * Tables are loaded once, by path, and shared by all connections; each
+ * method and window is built on first use through the NodeSet and reused by
+ * every later request. Every connection is served on its own thread.
+ */
+class QueryServer {
+public:
+  /**
+   * @brief Loads a text or binary node file, or finds it if already loaded.
+   * @param path Path to the file.
+   * @param table Receives the table id.
+   * @param error Receives the reason on failure.
+   * @return True on success.
+   */
+  bool load(const std::string &path, std::uint32_t &table,
+            std::string &error) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = paths.find(path);
+      if (it != paths.end()) {
+        table = it->second;
+        return true;
+      }
+    }
+
+    std::shared_ptr<const NodeSet> nodes;
+    if (is_node_file(path)) {
+      NodeFile node_file = load_node_file(path);
+      if (!node_file.status) {
+        error = node_file.error_message;
+        return false;
+      }
+      nodes = cache.get(node_file.node_set());
+    } else {
+      ParsingResult parsed = parse_file(path);
+      if (!parsed.status) {
+        error = parsed.error_line == 0
+                    ? parsed.error_message
+                    : "line " + std::to_string(parsed.error_line) +
+                          ", column " + std::to_string(parsed.error_column) +
+                          ": " + parsed.error_message;
+        return false;
+      }
+      nodes = cache.get(std::move(parsed.x_values), std::move(parsed.y_values));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto [it, inserted] =
+        paths.emplace(path, static_cast<std::uint32_t>(tables.size()));
+    if (inserted) {
+      tables.push_back(std::move(nodes));
+    }
+    table = it->second;
+    return true;
+  }
+
+  /**
+   * @brief Serves requests from in_fd, answering on out_fd, until the peer
+   * closes the connection or sends a malformed request.
+   *
+   * A request over kQueryMaxQueries or kQueryMaxPath gets an error reply
+   * before anything is allocated for it, and ends the connection, as its
+   * payload is not read.
+   */
+  void serve_connection(int in_fd, int out_fd) {
+    std::vector<double> queries, values;
+    std::string text;
+    QueryRequest request;
+    while (read_full(in_fd, &request, sizeof(request))) {
+      if (request.magic != kQueryMagic) {
+        return;
+      }
+      QueryResponse response{0, request.table, 0};
+      std::string error;
+      bool ok = true;
+      if ((request.op == QueryLoad && request.count > kQueryMaxPath) ||
+          (request.op == QueryEvaluate && request.count > kQueryMaxQueries)) {
+        error = request.op == QueryLoad ? "Path is too long"
+                                        : "Too many queries in one request";
+        response.status = 1;
+        response.count = error.size();
+        write_full(out_fd, &response, sizeof(response), error.data(),
+                   error.size());
+        return;
+      }
+      if (request.op == QueryLoad) {
+        text.resize(request.count);
+        if (!read_full(in_fd, &text[0], text.size())) {
+          return;
+        }
+        try {
+          ok = load(text, response.table, error);
+        } catch (const std::exception &e) {
+          // bad_alloc for a huge file, say; the server goes on.
+          error = e.what();
+          ok = false;
+        }
+      } else if (request.op == QueryEvaluate) {
+        queries.resize(request.count);
+        values.resize(request.count);
+        if (!read_full(in_fd, queries.data(), queries.size() * 8)) {
+          return;
+        }
+        ok = evaluate(request, queries, values, error);
+        response.count = ok ? request.count : 0;
+      } else {
+        return;
+      }
+
+      bool sent;
+      if (ok) {
+        sent = write_full(out_fd, &response, sizeof(response), values.data(),
+                          response.count * 8);
+      } else {
+        response.status = 1;
+        response.count = error.size();
+        sent = write_full(out_fd, &response, sizeof(response), error.data(),
+                          error.size());
+      }
+      if (!sent) {
+        return;
+      }
+    }
+  }
+
+  /**
+   * @brief Listens on a Unix domain socket and serves every client on its own
+   * thread. Returns only if the socket cannot be set up.
+   * @param socket_path Path of the socket; an existing file there is removed.
+   * @param error Receives the reason on failure.
+   * @return False on failure.
+   */
+  bool listen(const std::string &socket_path, std::string &error) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+      error = "Socket path is too long";
+      return false;
+    }
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+      error = std::strerror(errno);
+      return false;
+    }
+    ::unlink(socket_path.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) !=
+            0 ||
+        ::listen(fd, SOMAXCONN) != 0) {
+      error = std::strerror(errno);
+      ::close(fd);
+      return false;
+    }
+    for (;;) {
+      int client = ::accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+      if (client < 0) {
+        if (errno == EINTR || errno == ECONNABORTED) {
+          continue;
+        }
+        if (errno == EMFILE || errno == ENFILE) {
+          // The pending connection stays queued; retrying at once would spin
+          // until a connection thread closes its descriptor.
+          std::this_thread::sleep_for(kQueryAcceptBackoff);
+          continue;
+        }
+        error = std::strerror(errno);
+        ::close(fd);
+        return false;
+      }
+      disable_sigpipe(client);
+      std::thread([this, client] {
+        serve_connection(client, client);
+        ::close(client);
+      }).detach();
+    }
+  }
+
+private:
+  std::mutex mutex; ///< Guards tables and paths.
+  std::vector<std::shared_ptr<const NodeSet>> tables;
+  std::map<std::string, std::uint32_t> paths;
+  NodeSetCache cache;
+
+  bool evaluate(const QueryRequest &request, const std::vector<double> &queries,
+                std::vector<double> &values, std::string &error) {
+    std::shared_ptr<const NodeSet> nodes;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (request.table < tables.size()) {
+        nodes = tables[request.table];
+      }
+    }
+    if (!nodes) {
+      error = "Unknown table";
+      return false;
+    }
+    if (request.method > IntepolationCalculator::Bessel) {
+      error = "Unknown interpolation method";
+      return false;
+    }
+    if (request.window < 0) {
+      error = "Window must not be negative";
+      return false;
+    }
+    try {
+      IntepolationCalculator calculator(
+          static_cast<IntepolationCalculator::InterpolationMethod>(
+              request.method),
+          nodes, request.window);
+      calculator.interpolate_many(queries.data(), queries.size(),
+                                  values.data());
+    } catch (const std::exception &e) {
+      error = e.what();
+      return false;
+    }
+    return true;
+  }
+};
+
+/**
+ * @brief Blocking client for a QueryServer.
+ */
+class QueryClient {
+public:
+  QueryClient() = default;
+  QueryClient(const QueryClient &) = delete;
+  QueryClient &operator=(const QueryClient &) = delete;
+  ~QueryClient() { close(); }
+
+  /**
+   * @brief Connects to the server's Unix domain socket.
+   * @return False on failure.
+   */
+  bool connect(const std::string &socket_path) {
+    close();
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+      return false;
+    }
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+      return false;
+    }
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&address),
+                  sizeof(address)) != 0) {
+      close();
+      return false;
+    }
+    disable_sigpipe(fd);
+    return true;
+  }
+
+  void close() {
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+
+  /**
+   * @brief Asks the server to load a node file.
+   * @param path Path to the file, as seen by the server.
+   * @param table Receives the table id.
+   * @param error Receives the reason on failure.
+   * @return True on success.
+   */
+  bool load(const std::string &path, std::uint32_t &table,
+            std::string &error) {
+    QueryRequest request{kQueryMagic, QueryLoad, 0, 0, 0, path.size()};
+    if (!write_full(fd, &request, sizeof(request), path.data(), path.size())) {
+      error = "Connection lost";
+      return false;
+    }
+    QueryResponse response;
+    if (!receive(response, nullptr, 0, error)) {
+      return false;
+    }
+    table = response.table;
+    return true;
+  }
+
+  /**
+   * @brief Evaluates a table at a batch of query points.
+   * @param table Table id from load().
+   * @param method The interpolation method.
+   * @param window Window size, 0 for a global polynomial.
+   * @param queries Pointer to count query points.
+   * @param count Number of query points, at most kQueryMaxQueries.
+   * @param out Pointer to count output values.
+   * @param error Receives the reason on failure.
+   * @return True on success.
+   */
+  bool evaluate(std::uint32_t table,
+                IntepolationCalculator::InterpolationMethod method, int window,
+                const double *queries, std::size_t count, double *out,
+                std::string &error) {
+    if (count > kQueryMaxQueries) {
+      error = "Too many queries in one request";
+      return false;
+    }
+    QueryRequest request{kQueryMagic,
+                         QueryEvaluate,
+                         static_cast<std::uint16_t>(method),
+                         table,
+                         window,
+                         count};
+    if (!write_full(fd, &request, sizeof(request), queries, count * 8)) {
+      error = "Connection lost";
+      return false;
+    }
+    QueryResponse response;
+    return receive(response, out, count, error);
+  }
+
+private:
+  int fd = -1;
+
+  bool receive(QueryResponse &response, double *out, std::size_t count,
+               std::string &error) {
+    if (!read_full(fd, &response, sizeof(response))) {
+      error = "Connection lost";
+      return false;
+    }
+    if (response.status != 0) {
+      error.resize(response.count);
+      if (!read_full(fd, &error[0], error.size())) {
+        error = "Connection lost";
+      }
+      return false;
+    }
+    if (response.count != count ||
+        !read_full(fd, out, response.count * 8)) {
+      error = "Connection lost";
+      return false;
+    }
+    return true;
+  }
+};
+
+#endif /* FF956B05_2C52_431A_9BDC_6B6B34E074CB */
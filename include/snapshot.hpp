@@ -0,0 +1,511 @@
+#ifndef A38B2F21_46D9_4122_93E2_E249E49742B0
+#define A38B2F21_46D9_4122_93E2_E249E49742B0
+
+#include "difference_table.hpp"
+#include "interpolant.hpp"
+#include "interpolation_calc.hpp"
+#include "mapped_file.hpp"
+#include "node_set.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <list>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+/// First bytes of every snapshot file.
+constexpr char kSnapshotMagic[8] = {'I', 'N', 'T', 'P', 'S', 'N', 'A', 'P'};
+
+/// Current version of the snapshot format; also bumped whenever the
+/// alternatives of Interpolant or their fields() change, or build() picks a
+/// different alternative for a method.
+constexpr std::uint32_t kSnapshotVersion = 2;
+
+/// Alignment of every column in a snapshot file, in bytes.
+constexpr std::uint64_t kSnapshotAlign = 64;
+
+/**
+ * @brief Header at the start of a snapshot file.
+ *
+ * A snapshot holds a NodeSet: its nodes, its difference table if it was
+ * built, and every interpolant built from it. The header is followed by
+ * record_count SnapshotRecord entries and column_count SnapshotColumn
+ * entries, which locate float64 columns aligned to kSnapshotAlign. Columns 0
+ * and 1 are the x and y nodes, column 2 the packed difference table (empty
+ * if absent); each record owns a run of further columns, the first holding
+ * the scalar fields of its interpolant and the others its arrays, in the
+ * order of fields(). Byte order is that of the writing machine.
+ */
+struct SnapshotHeader {
+  char magic[8];             ///< kSnapshotMagic.
+  std::uint32_t version;     ///< kSnapshotVersion.
+  std::uint32_t header_size; ///< sizeof(SnapshotHeader).
+  std::uint64_t node_count;
+  std::uint64_t checksum; ///< NodeSet::hash() of the nodes.
+  std::uint32_t record_count;
+  std::uint32_t column_count;
+  std::uint64_t records_offset;   ///< Byte offset of the records.
+  std::uint64_t columns_offset;   ///< Byte offset of the column entries.
+  std::uint64_t columns_checksum; ///< hash_values() of all columns in order.
+};
+static_assert(sizeof(SnapshotHeader) == 64, "SnapshotHeader must be packed");
+
+/**
+ * @brief One saved interpolant.
+ */
+struct SnapshotRecord {
+  std::uint32_t method; ///< IntepolationCalculator::InterpolationMethod.
+  std::int32_t window;
+  std::uint32_t kind;         ///< Index of the alternative in Interpolant.
+  std::uint32_t first_column; ///< Column of the scalar fields.
+  std::uint32_t column_count; ///< Scalar column plus one per array field.
+  std::uint32_t reserved;
+};
+static_assert(sizeof(SnapshotRecord) == 24, "SnapshotRecord must be packed");
+
+/**
+ * @brief Location of one float64 column.
+ */
+struct SnapshotColumn {
+  std::uint64_t offset; ///< Byte offset, a multiple of kSnapshotAlign.
+  std::uint64_t count;  ///< Number of values.
+};
+static_assert(sizeof(SnapshotColumn) == 16, "SnapshotColumn must be packed");
+
+/**
+ * @brief Collects the fields of an interpolant for save_snapshot().
+ */
+struct SnapshotSaver {
+  std::vector<double> &scalars;
+  std::vector<ValueSpan> &columns;
+
+  void operator()(const std::vector<double> &v) { columns.emplace_back(v); }
+  template <std::size_t N> void operator()(const std::array<double, N> &v) {
+    columns.emplace_back(v.data(), N);
+  }
+  template <class T> void operator()(const T &v) {
+    static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>,
+                  "Unsupported field type");
+    scalars.push_back(static_cast<double>(v));
+  }
+};
+
+/**
+ * @brief Fills the fields of an interpolant for load_snapshot().
+ */
+struct SnapshotLoader {
+  ValueSpan scalars;
+  const ValueSpan *arrays;
+  std::size_t array_count;
+  std::size_t next_scalar = 0, next_array = 0;
+  bool ok = true;
+
+  void operator()(std::vector<double> &v) {
+    if (next_array < array_count) {
+      v = arrays[next_array].to_vector();
+    } else {
+      ok = false;
+    }
+    next_array++;
+  }
+  template <std::size_t N> void operator()(std::array<double, N> &v) {
+    if (next_array < array_count && arrays[next_array].size() == N) {
+      std::copy_n(arrays[next_array].data(), N, v.begin());
+    } else {
+      ok = false;
+    }
+    next_array++;
+  }
+  template <class T> void operator()(T &v) {
+    if (next_scalar >= scalars.size()) {
+      ok = false;
+      return;
+    }
+    double d = scalars[next_scalar++];
+    if constexpr (std::is_enum_v<T>) {
+      v = static_cast<T>(static_cast<int>(d));
+    } else {
+      v = static_cast<T>(d);
+    }
+  }
+
+  /// True if every field was read and every column consumed.
+  bool complete() const {
+    return ok && next_scalar == scalars.size() && next_array == array_count;
+  }
+};
+
+/**
+ * @brief Tells whether a file starts with the snapshot magic.
+ */
+inline bool is_snapshot_file(const std::string &filename) {
+  std::ifstream file(filename, std::ios::binary);
+  char magic[sizeof(kSnapshotMagic)];
+  return file.read(magic, sizeof(magic)) &&
+         std::memcmp(magic, kSnapshotMagic, sizeof(magic)) == 0;
+}
+
+/**
+ * @brief File name for snapshots of a NodeSet kept in a cache directory: the
+ * hash of its nodes in hex followed by ".snap".
+ */
+inline std::string snapshot_name(const NodeSet &nodes) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.snap",
+                static_cast<unsigned long long>(nodes.hash()));
+  return name;
+}
+
+/**
+ * @brief Saves nodes, the difference table if built and every interpolant
+ * built so far.
+ * @param filename Path to the file.
+ * @param nodes The NodeSet.
+ * @return True on success.
+ */
+inline bool save_snapshot(const std::string &filename, const NodeSet &nodes) {
+  INTERP_PROFILE_SCOPE("save_snapshot");
+  std::size_t n = nodes.x().size();
+  std::vector<ValueSpan> columns = {nodes.x(), nodes.y(), ValueSpan()};
+  if (nodes.has_difference_table()) {
+    columns[2] = ValueSpan(nodes.difference_table().packed(), n * (n + 1) / 2);
+  }
+  std::vector<SnapshotRecord> records;
+  std::list<std::vector<double>> scalars;
+  nodes.for_each_interpolant(
+      [&](int method, int window, const Interpolant &interpolant) {
+        SnapshotRecord record{};
+        record.method = static_cast<std::uint32_t>(method);
+        record.window = window;
+        record.kind = static_cast<std::uint32_t>(interpolant.index());
+        record.first_column = static_cast<std::uint32_t>(columns.size());
+        columns.emplace_back();
+        SnapshotSaver saver{scalars.emplace_back(), columns};
+        std::visit(
+            [&](const auto &f) {
+              std::decay_t<decltype(f)>::fields(f, saver);
+            },
+            interpolant);
+        columns[record.first_column] = scalars.back();
+        record.column_count =
+            static_cast<std::uint32_t>(columns.size()) - record.first_column;
+        records.push_back(record);
+      });
+
+  auto align = [](std::uint64_t offset) {
+    return (offset + kSnapshotAlign - 1) / kSnapshotAlign * kSnapshotAlign;
+  };
+  SnapshotHeader header{};
+  std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+  header.version = kSnapshotVersion;
+  header.header_size = sizeof(SnapshotHeader);
+  header.node_count = n;
+  header.checksum = nodes.hash();
+  header.record_count = static_cast<std::uint32_t>(records.size());
+  header.column_count = static_cast<std::uint32_t>(columns.size());
+  header.records_offset = align(sizeof(SnapshotHeader));
+  header.columns_offset =
+      align(header.records_offset + records.size() * sizeof(SnapshotRecord));
+  std::vector<SnapshotColumn> entries(columns.size());
+  std::uint64_t offset =
+      align(header.columns_offset + entries.size() * sizeof(SnapshotColumn));
+  header.columns_checksum = hash_values(nullptr, 0);
+  for (std::size_t i = 0; i < columns.size(); i++) {
+    entries[i] = {offset, columns[i].size()};
+    offset = align(offset + columns[i].size() * 8);
+    header.columns_checksum = hash_values(
+        columns[i].data(), columns[i].size(), header.columns_checksum);
+  }
+
+  // Written next to the target and renamed over it, so a crash mid-write
+  // cannot leave a truncated snapshot behind.
+  char suffix[40];
+  std::snprintf(suffix, sizeof(suffix), ".%016llx.tmp",
+                static_cast<unsigned long long>(
+                    std::hash<std::thread::id>()(std::this_thread::get_id()) ^
+                    static_cast<std::uint64_t>(
+                        std::chrono::steady_clock::now()
+                            .time_since_epoch()
+                            .count())));
+  std::string temporary = filename + suffix;
+  std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    return false;
+  }
+  std::uint64_t position = 0;
+  auto put = [&](const void *data, std::uint64_t at, std::uint64_t bytes) {
+    static const char zeros[kSnapshotAlign] = {};
+    file.write(zeros, static_cast<std::streamsize>(at - position));
+    file.write(static_cast<const char *>(data),
+               static_cast<std::streamsize>(bytes));
+    position = at + bytes;
+  };
+  put(&header, 0, sizeof(header));
+  put(records.data(), header.records_offset,
+      records.size() * sizeof(SnapshotRecord));
+  put(entries.data(), header.columns_offset,
+      entries.size() * sizeof(SnapshotColumn));
+  for (std::size_t i = 0; i < columns.size(); i++) {
+    put(columns[i].data(), entries[i].offset, columns[i].size() * 8);
+  }
+  file.close();
+  if (file.fail() || std::rename(temporary.c_str(), filename.c_str()) != 0) {
+    std::remove(temporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Saves the NodeSet of a calculator, see above.
+ */
+inline bool save_snapshot(const std::string &filename,
+                          const IntepolationCalculator &calculator) {
+  return save_snapshot(filename, *calculator.get_node_set());
+}
+
+/**
+ * @brief Tells whether a restored interpolant is one that
+ * IntepolationCalculator::build() could have made for its key, with every
+ * array sized for n nodes, so that evaluating it stays in bounds.
+ * @param interpolant The interpolant, filled from the snapshot.
+ * @param method Its method.
+ * @param window Its window.
+ * @param n Number of nodes of the snapshot.
+ */
+inline bool snapshot_record_fits(const Interpolant &interpolant, int method,
+                                 int window, std::uint64_t n) {
+  using Calculator = IntepolationCalculator;
+  std::vector<double> scalars;
+  std::vector<ValueSpan> arrays;
+  SnapshotSaver shape{scalars, arrays};
+  std::visit(
+      [&](const auto &f) { std::decay_t<decltype(f)>::fields(f, shape); },
+      interpolant);
+  auto sizes = [&](std::initializer_list<std::uint64_t> expected) {
+    return std::equal(arrays.begin(), arrays.end(), expected.begin(),
+                      expected.end(), [](ValueSpan a, std::uint64_t size) {
+                        return a.size() == size;
+                      });
+  };
+  bool global = window == 0 || static_cast<std::uint64_t>(window) >= n;
+  if (n == 0 || window < 0) {
+    return false;
+  }
+  return std::visit(
+      [&](const auto &f) {
+        using T = std::decay_t<decltype(f)>;
+        if constexpr (std::is_same_v<T, LagrangeInterpolant>) {
+          return global && method == Calculator::Lagrange && sizes({n, n, n});
+        } else if constexpr (std::is_same_v<T, NewtonInterpolant>) {
+          return global && method == Calculator::NewtonSeparated &&
+                 sizes({n, n, n});
+        } else if constexpr (std::is_same_v<T, NewtonFiniteInterpolant>) {
+          return global && method == Calculator::NewtonFinite &&
+                 sizes({n, n});
+        } else if constexpr (std::is_same_v<T, StirlingInterpolant>) {
+          auto order = static_cast<std::uint64_t>(
+              stirling_order(static_cast<int>(n) - 1));
+          return global && method == Calculator::Stirling &&
+                 sizes({order + 1});
+        } else if constexpr (std::is_same_v<T, BesselInterpolant>) {
+          return global && method == Calculator::Bessel && sizes({n});
+        } else if constexpr (std::is_same_v<T, WindowedInterpolant>) {
+          // Scalars: form, window, h.
+          auto form = method == Calculator::NewtonFinite ? T::Forward
+                      : method == Calculator::Stirling   ? T::Stirling
+                      : method == Calculator::Bessel     ? T::Bessel
+                                                         : T::Divided;
+          bool parity = method == Calculator::Stirling   ? window % 2 != 0
+                        : method == Calculator::Bessel ? window % 2 == 0
+                                                       : true;
+          return !global && window <= WindowedInterpolant::kMaxWindow &&
+                 parity &&
+                 method >= Calculator::Lagrange &&
+                 method <= Calculator::Bessel && scalars[0] == form &&
+                 scalars[1] == window &&
+                 sizes({n, n * static_cast<std::uint64_t>(window)});
+        } else {
+          // FixedInterpolant<N>; scalars: form, a, h.
+          auto form = method == Calculator::Lagrange   ? T::Barycentric
+                      : method == Calculator::Stirling ? T::Stirling
+                                                       : T::Bessel;
+          return global && n == arrays[0].size() &&
+                 (method == Calculator::Lagrange ||
+                  method == Calculator::Stirling ||
+                  method == Calculator::Bessel) &&
+                 scalars[0] == form;
+        }
+      },
+      interpolant);
+}
+
+/**
+ * @brief Default-constructed alternative number kind of Interpolant.
+ */
+template <std::size_t... I>
+Interpolant make_interpolant(std::size_t kind, std::index_sequence<I...>) {
+  Interpolant result;
+  ((kind == I ? (void)result.template emplace<I>() : (void)0), ...);
+  return result;
+}
+
+/**
+ * @brief Result of load_snapshot().
+ */
+struct Snapshot {
+  bool status = false;
+  std::string error_message;
+  std::shared_ptr<const NodeSet> nodes; ///< With the saved data installed.
+  std::size_t interpolant_count = 0;    ///< Number of interpolants restored.
+};
+
+/**
+ * @brief Reads a snapshot and installs its difference table and
+ * interpolants into a NodeSet over the same nodes.
+ *
+ * Nothing is recomputed: the columns are copied straight from the mapped
+ * file. Every interpolant is checked against its method, window and the
+ * node count before any is installed, and a file that fails any check
+ * installs nothing. Interpolants the NodeSet already has are kept.
+ * @param filename Path to the file.
+ * @param nodes Receives the saved data; if null, a NodeSet over the mapped
+ * nodes is created, which keeps the mapping alive.
+ * @param verify Check the columns against the stored checksum. This reads
+ * every value, which installing them does anyway; turn it off only for a
+ * file just written by this process.
+ * @return status = false with the reason on failure, including when the
+ * nodes of the snapshot differ from those of nodes.
+ */
+inline Snapshot load_snapshot(const std::string &filename,
+                              std::shared_ptr<const NodeSet> nodes = nullptr,
+                              bool verify = true) {
+  INTERP_PROFILE_SCOPE("load_snapshot");
+  Snapshot result;
+  auto mapping = std::make_shared<MappedFile>(filename);
+  if (!mapping->is_open()) {
+    result.error_message = "Cannot open file";
+    return result;
+  }
+  auto fail = [&](const char *message) {
+    result.error_message = message;
+    return std::move(result);
+  };
+  SnapshotHeader header;
+  if (mapping->size() < sizeof(header)) {
+    return fail("File is too short for a snapshot header");
+  }
+  std::memcpy(&header, mapping->data(), sizeof(header));
+  if (std::memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0) {
+    return fail("Not a snapshot file");
+  }
+  if (header.version != kSnapshotVersion ||
+      header.header_size != sizeof(SnapshotHeader)) {
+    return fail("Unsupported snapshot version");
+  }
+
+  std::uint64_t size = mapping->size();
+  auto fits = [size](std::uint64_t offset, std::uint64_t count,
+                     std::uint64_t item) {
+    return offset <= size && count <= (size - offset) / item;
+  };
+  if (header.column_count < 3 ||
+      !fits(header.records_offset, header.record_count,
+            sizeof(SnapshotRecord)) ||
+      !fits(header.columns_offset, header.column_count,
+            sizeof(SnapshotColumn))) {
+    return fail("Snapshot is truncated or corrupt");
+  }
+  std::vector<SnapshotRecord> records(header.record_count);
+  std::vector<SnapshotColumn> entries(header.column_count);
+  std::memcpy(records.data(), mapping->data() + header.records_offset,
+              records.size() * sizeof(SnapshotRecord));
+  std::memcpy(entries.data(), mapping->data() + header.columns_offset,
+              entries.size() * sizeof(SnapshotColumn));
+  std::vector<ValueSpan> columns(entries.size());
+  std::uint64_t checksum = hash_values(nullptr, 0);
+  for (std::size_t i = 0; i < entries.size(); i++) {
+    if (entries[i].offset % kSnapshotAlign != 0 ||
+        !fits(entries[i].offset, entries[i].count, 8)) {
+      return fail("Snapshot is truncated or corrupt");
+    }
+    columns[i] = ValueSpan(
+        reinterpret_cast<const double *>(mapping->data() + entries[i].offset),
+        static_cast<std::size_t>(entries[i].count));
+    if (verify) {
+      checksum = hash_values(columns[i].data(), columns[i].size(), checksum);
+    }
+  }
+  if (verify && checksum != header.columns_checksum) {
+    return fail("Snapshot checksum mismatch");
+  }
+  std::uint64_t n = header.node_count;
+  if (columns[0].size() != n || columns[1].size() != n ||
+      (!columns[2].empty() && columns[2].size() != n * (n + 1) / 2)) {
+    return fail("Snapshot is truncated or corrupt");
+  }
+
+  if (!nodes) {
+    nodes = std::make_shared<const NodeSet>(columns[0], columns[1], mapping,
+                                            header.checksum);
+  } else if (nodes->hash() != header.checksum || nodes->x() != columns[0] ||
+             nodes->y() != columns[1]) {
+    return fail("Snapshot was taken of different nodes");
+  }
+
+  // Everything is read and checked before anything is installed, so a file
+  // that fails partway leaves nodes untouched.
+  constexpr std::size_t kinds = std::variant_size_v<Interpolant>;
+  std::vector<Interpolant> interpolants;
+  interpolants.reserve(records.size());
+  for (const auto &record : records) {
+    if (record.kind >= kinds || record.column_count == 0 ||
+        record.first_column >= columns.size() ||
+        record.column_count > columns.size() - record.first_column) {
+      return fail("Snapshot is truncated or corrupt");
+    }
+    Interpolant &interpolant = interpolants.emplace_back(
+        make_interpolant(record.kind, std::make_index_sequence<kinds>()));
+    SnapshotLoader loader{columns[record.first_column],
+                          &columns[record.first_column + 1],
+                          record.column_count - 1u};
+    std::visit(
+        [&](auto &f) { std::decay_t<decltype(f)>::fields(f, loader); },
+        interpolant);
+    if (!loader.complete()) {
+      return fail("Snapshot does not match this version of the interpolants");
+    }
+    if (!snapshot_record_fits(interpolant, static_cast<int>(record.method),
+                              record.window, n)) {
+      return fail("Snapshot is truncated or corrupt");
+    }
+  }
+
+  if (!columns[2].empty()) {
+    nodes->set_difference_table(DifferenceTable::from_packed(
+        columns[2].data(), static_cast<std::size_t>(n)));
+  }
+  for (std::size_t i = 0; i < records.size(); i++) {
+    nodes->interpolant(static_cast<int>(records[i].method), records[i].window,
+                       [&] { return std::move(interpolants[i]); });
+    result.interpolant_count++;
+  }
+
+  result.nodes = std::move(nodes);
+  result.status = true;
+  return result;
+}
+
+#endif /* A38B2F21_46D9_4122_93E2_E249E49742B0 */
@@ -26,8 +26,8 @@
 #include <QtWidgets/QStatusBar>
 #include <QtWidgets/QTabWidget>
 #include <QtWidgets/QTableWidget>
-#include <QtWidgets/QTextBrowser>
 #include <QtWidgets/QTextEdit>
+#include <QtWidgets/QToolBox>
 #include <QtWidgets/QVBoxLayout>
 #include <QtWidgets/QWidget>
 
@@ -89,7 +89,8 @@ public:
   QFrame *frame_result;
   QVBoxLayout *verticalLayout_3;
   QLabel *label_3;
-  QTextBrowser *textBrowser;
+  QToolBox *results_box;
+  QPushButton *cancel_btn;
   QGroupBox *groupBox_22;
   QVBoxLayout *verticalLayout_6;
   QWebEngineView *webview;
@@ -411,10 +412,16 @@ public:
 
     verticalLayout_3->addWidget(label_3);
 
-    textBrowser = new QTextBrowser(frame_result);
-    textBrowser->setObjectName(QString::fromUtf8("textBrowser"));
+    results_box = new QToolBox(frame_result);
+    results_box->setObjectName(QString::fromUtf8("results_box"));
 
-    verticalLayout_3->addWidget(textBrowser);
+    verticalLayout_3->addWidget(results_box);
+
+    cancel_btn = new QPushButton(frame_result);
+    cancel_btn->setObjectName(QString::fromUtf8("cancel_btn"));
+    cancel_btn->setEnabled(false);
+
+    verticalLayout_3->addWidget(cancel_btn);
 
     verticalLayout->addWidget(frame_result);
 
@@ -507,6 +514,8 @@ public:
         "MainWindow", "Calculate F(X) in point with X:", nullptr));
     label_3->setText(QCoreApplication::translate(
         "MainWindow", "Calculation result", nullptr));
+    cancel_btn->setText(
+        QCoreApplication::translate("MainWindow", "Cancel", nullptr));
   } // retranslateUi
 };
 
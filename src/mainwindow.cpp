@@ -1,13 +1,41 @@
 #include "mainwindow.hpp"
+#include "difference_table_model.hpp"
 #include "file_parser.hpp"
 #include "interpolation_calc.hpp"
+#include "node_file.hpp"
+#include "profiler.hpp"
+#include "snapshot.hpp"
+#include <QDir>
+#include <QFile>
+#include <QHeaderView>
+#include <QMenu>
+#include <QStandardPaths>
+#include <QTableView>
+#include <QTextBrowser>
+#include <QToolBox>
+#include <QVBoxLayout>
 #include <QWidget>
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
 #include <cmath>
-#include <iomanip>
+#include <iterator>
 #include <qpushbutton.h>
-#include <sstream>
+#include <tuple>
+#include <utility>
 #include <vector>
 
+/// Number of query results listed per method for a file with many queries.
+constexpr std::size_t kShownQueries = 20;
+
+/// Leading and trailing terms shown of longer formulas, see to_latex().
+constexpr std::size_t kLatexTerms = 25;
+
+/// Methods computed by every run, each on its own worker thread.
+constexpr IntepolationCalculator::InterpolationMethod kMethods[] = {
+    IntepolationCalculator::Lagrange, IntepolationCalculator::NewtonSeparated,
+    IntepolationCalculator::NewtonFinite, IntepolationCalculator::Bessel,
+    IntepolationCalculator::Stirling};
+
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
   ui->setupUi(this);
 
@@ -51,10 +79,39 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
           &MainWindow::on_add_btn_clicked);
   connect(ui->remove_point_btn, &QPushButton::clicked, this,
           &MainWindow::on_remove_btn_clicked);
+
+  connect(ui->results_box, &QToolBox::currentChanged, this,
+          &MainWindow::render_section);
+
+  // A run is stale once its inputs change.
+  connect(ui->cancel_btn, &QPushButton::clicked, this,
+          &MainWindow::cancel_run);
+  connect(ui->file_path_edit, &QTextEdit::textChanged, this,
+          &MainWindow::cancel_run);
+  connect(ui->tableWidget, &QTableWidget::itemChanged, this,
+          &MainWindow::cancel_run);
+  for (auto *spin_box : {ui->start_sb, ui->end_sb, ui->point_y_value_box}) {
+    connect(spin_box, QOverload<double>::of(&QDoubleSpinBox::valueChanged),
+            this, &MainWindow::cancel_run);
+  }
+  connect(ui->nodes_count_sb, QOverload<int>::of(&QSpinBox::valueChanged),
+          this, &MainWindow::cancel_run);
+  connect(ui->sinx_rb, &QRadioButton::toggled, this,
+          &MainWindow::cancel_run);
+
+#ifdef INTERP_PROFILING
+  QMenu *profile_menu = ui->menubar->addMenu(tr("Profile"));
+  profile_menu->addAction(tr("Export JSON..."), this,
+                          [this] { export_profile(false); });
+  profile_menu->addAction(tr("Export Chrome trace..."), this,
+                          [this] { export_profile(true); });
+#endif
 }
 
 void MainWindow::on_calculation_func_btn_clicked() {
-  ui->textBrowser->clear();
+  INTERP_PROFILE_BEGIN_RUN();
+  stop_run();
+  clear_results();
   double start = ui->start_sb->value();
   double end = ui->end_sb->value();
   int nodes = ui->nodes_count_sb->value();
@@ -78,106 +135,85 @@ void MainWindow::on_calculation_func_btn_clicked() {
     func = [](double x) { return std::cos(x); };
   }
 
-  auto [x, y] =
-      IntepolationCalculator::generate_func_values(func, start, end, nodes);
-
-  for (auto &method :
-       {IntepolationCalculator::Lagrange,
-        IntepolationCalculator::NewtonSeparated,
-        IntepolationCalculator::NewtonFinite, IntepolationCalculator::Bessel,
-        IntepolationCalculator::Stirling}) {
-    auto calculator = IntepolationCalculator(method, x, y);
-    auto interpolated_value = calculator.interpolate()(point);
-    auto latex = calculator.to_latex();
-    auto difference_table = calculator.difference_table();
-    auto nodes = calculator.get_nodes();
-    auto method_name = IntepolationCalculator::method_to_string(method);
-
-    ui->textBrowser->append("<h3>Method: " + QString(method_name.c_str()) +
-                            "</h3>");
-    ui->textBrowser->append("<b>Interpolated value: </b>" +
-                            QString::number(interpolated_value));
-    ui->textBrowser->append("<b>Function: </b>" + QString(latex.c_str()));
-    ui->textBrowser->append("<b>Nodes: </b>");
-    for (auto [x, y] : nodes) {
-      ui->textBrowser->append(
-          "(" + (QString::number(x) + " " + QString::number(y) + ")"));
-    }
-    ui->textBrowser->append("<b>Difference table: </b>");
-    for (const auto &row : difference_table) {
-      std::stringstream ss;
-      for (const auto &x : row) {
-        ss << std::setw(8) << std::fixed << std::setprecision(2) << x << " ";
-      }
-      ui->textBrowser->append(ss.str().c_str());
-    }
-
-    if (method == IntepolationCalculator::NewtonSeparated) {
-      draw_chart(nodes, latex);
-    }
-
-    ui->textBrowser->append("");
+  std::vector<double> x, y;
+  {
+    INTERP_PROFILE_SCOPE("gui.generate");
+    std::tie(x, y) =
+        IntepolationCalculator::generate_func_values(func, start, end, nodes);
   }
+  start_run(node_cache.get(x, y), {point});
 }
 
 void MainWindow::on_calculation_file_btn_clicked() {
-  auto parsing_result =
-      parse_file(ui->file_path_edit->toPlainText().toStdString());
-  if (!parsing_result.status) {
-    ui->statusbar->showMessage(QString::fromStdString("Failed to parse file"));
-    return;
-  }
-
-  if (parsing_result.x_values.size() < 3) {
-    ui->statusbar->showMessage("Table must have at least 3 rows");
-    return;
-  }
-
-  for (auto &method :
-       {IntepolationCalculator::Lagrange,
-        IntepolationCalculator::NewtonSeparated,
-        IntepolationCalculator::NewtonFinite, IntepolationCalculator::Bessel,
-        IntepolationCalculator::Stirling}) {
-    auto calculator = IntepolationCalculator(method, parsing_result.x_values,
-                                             parsing_result.y_values);
-    auto interpolated_value =
-        calculator.interpolate()(parsing_result.firstValue);
-    auto latex = calculator.to_latex();
-    auto difference_table = calculator.difference_table();
-    auto nodes = calculator.get_nodes();
-    auto method_name = IntepolationCalculator::method_to_string(method);
-
-    ui->textBrowser->append("<h3>Method: " + QString(method_name.c_str()) +
-                            "</h3>");
-    ui->textBrowser->append("<b>Interpolated value: </b>" +
-                            QString::number(interpolated_value));
-    ui->textBrowser->append("<b>Function: </b>" + QString(latex.c_str()));
-    ui->textBrowser->append("<b>Nodes: </b>");
-    for (auto [x, y] : nodes) {
-      ui->textBrowser->append(
-          "(" + (QString::number(x) + " " + QString::number(y) + ")"));
+  INTERP_PROFILE_BEGIN_RUN();
+  stop_run();
+  auto file_name = ui->file_path_edit->toPlainText().toStdString();
+  std::shared_ptr<const NodeSet> node_set;
+  std::vector<double> queries;
+  if (is_node_file(file_name)) {
+    auto node_file = load_node_file(file_name);
+    if (!node_file.status) {
+      ui->statusbar->showMessage(
+          QString("Failed to load node file: %1")
+              .arg(QString::fromStdString(node_file.error_message)));
+      return;
     }
-    if (method != IntepolationCalculator::Lagrange) {
-      ui->textBrowser->append("<b>Difference table: </b>");
-      for (const auto &row : difference_table) {
-        std::stringstream ss;
-        for (const auto &x : row) {
-          ss << std::setw(8) << std::fixed << std::setprecision(2) << x << " ";
-        }
-        ui->textBrowser->append(ss.str().c_str());
-      }
+    if (node_file.queries.empty()) {
+      ui->statusbar->showMessage("Node file has no query point");
+      return;
+    }
+    if (node_file.x_values.size() < 3) {
+      ui->statusbar->showMessage("Table must have at least 3 rows");
+      return;
+    }
+    queries = node_file.queries.to_vector();
+    node_set = node_cache.get(node_file.node_set());
+  } else {
+    auto parsing_result = parse_file(file_name);
+    if (!parsing_result.status) {
+      ui->statusbar->showMessage(
+          parsing_result.error_line == 0
+              ? QString("Failed to parse file: %1")
+                    .arg(QString::fromStdString(parsing_result.error_message))
+              : QString("Failed to parse file at line %1, column %2: %3")
+                    .arg(parsing_result.error_line)
+                    .arg(parsing_result.error_column)
+                    .arg(QString::fromStdString(
+                        parsing_result.error_message)));
+      return;
     }
 
-    if (method == IntepolationCalculator::NewtonSeparated) {
-      draw_chart(nodes, latex);
+    if (parsing_result.x_values.size() < 3) {
+      ui->statusbar->showMessage("Table must have at least 3 rows");
+      return;
     }
 
-    ui->textBrowser->append("");
+    queries = std::move(parsing_result.queries);
+    node_set = node_cache.get(std::move(parsing_result.x_values),
+                              std::move(parsing_result.y_values));
   }
+
+  // Interpolants of files seen before come from a snapshot in the cache
+  // directory instead of being rebuilt.
+  QString snapshot_dir =
+      QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+  std::string snapshot = QDir(snapshot_dir)
+                             .filePath(snapshot_name(*node_set).c_str())
+                             .toStdString();
+  bool restored = load_snapshot(snapshot, node_set).status;
+
+  start_run(node_set, std::move(queries),
+            [node_set, snapshot, snapshot_dir, restored] {
+              if (!restored && QDir().mkpath(snapshot_dir)) {
+                save_snapshot(snapshot, *node_set);
+              }
+            });
 }
 
 void MainWindow::on_calculation_table_btn_clicked() {
-  ui->textBrowser->clear();
+  INTERP_PROFILE_BEGIN_RUN();
+  stop_run();
+  clear_results();
   double point = ui->point_y_value_box->value();
 
   if (ui->tableWidget->rowCount() < 3) {
@@ -185,50 +221,192 @@ void MainWindow::on_calculation_table_btn_clicked() {
     return;
   }
 
-  for (auto &method :
-       {IntepolationCalculator::Lagrange,
-        IntepolationCalculator::NewtonSeparated,
-        IntepolationCalculator::NewtonFinite, IntepolationCalculator::Bessel,
-        IntepolationCalculator::Stirling}) {
-    std::vector<double> x(ui->tableWidget->rowCount());
-    std::vector<double> y(ui->tableWidget->rowCount());
+  std::vector<double> x(ui->tableWidget->rowCount());
+  std::vector<double> y(ui->tableWidget->rowCount());
+  {
+    INTERP_PROFILE_SCOPE("gui.read_table");
     for (int i = 0; i < ui->tableWidget->rowCount(); i++) {
       x[i] = ui->tableWidget->item(i, 0)->text().toDouble();
       y[i] = ui->tableWidget->item(i, 1)->text().toDouble();
     }
-    auto calculator = IntepolationCalculator(method, x, y);
-    auto interpolated_value = calculator.interpolate()(point);
-    auto latex = calculator.to_latex();
-    auto difference_table = calculator.difference_table();
-    auto nodes = calculator.get_nodes();
-    auto method_name = IntepolationCalculator::method_to_string(method);
-
-    ui->textBrowser->append("<h3>Method: " + QString(method_name.c_str()) +
-                            "</h3>");
-    ui->textBrowser->append("<b>Interpolated value: </b>" +
-                            QString::number(interpolated_value));
-    ui->textBrowser->append("<b>Function: </b>" + QString(latex.c_str()));
-    ui->textBrowser->append("<b>Nodes: </b>");
-    for (auto [x, y] : nodes) {
-      ui->textBrowser->append(
-          "(" + (QString::number(x) + " " + QString::number(y) + ")"));
+  }
+  start_run(node_cache.get(x, y), {point});
+}
+
+void MainWindow::cancel_run() {
+  if (stop_run()) {
+    ui->statusbar->showMessage("Calculation cancelled");
+  }
+}
+
+/**
+ * @brief Builds and evaluates one method of a run; called on a worker thread.
+ *
+ * The formula is built here too, as it may need the global Newton
+ * interpolant; the node list and difference table are left to
+ * render_section(). The calculator checks the cancellation flag inside its
+ * quadratic loops, so a stale run gives up its thread soon even during a long
+ * global build.
+ */
+static MethodResult
+compute_method(IntepolationCalculator::InterpolationMethod method,
+               std::shared_ptr<const NodeSet> node_set,
+               std::shared_ptr<const std::vector<double>> queries,
+               std::shared_ptr<const std::atomic<bool>> cancelled) {
+  MethodResult result;
+  result.method = method;
+  try {
+    auto calculator = std::make_shared<const IntepolationCalculator>(
+        method, node_set, 0, cancelled);
+    if (*cancelled) {
+      return result;
     }
-    if (method != IntepolationCalculator::Lagrange) {
-      ui->textBrowser->append("<b>Difference table: </b>");
-      for (const auto &row : difference_table) {
-        std::stringstream ss;
-        for (const auto &x : row) {
-          ss << std::setw(8) << std::fixed << std::setprecision(2) << x << " ";
-        }
-        ui->textBrowser->append(ss.str().c_str());
+    result.values.resize(queries->size());
+    calculator->interpolate_many(queries->data(), queries->size(),
+                                 result.values.data());
+    if (method == IntepolationCalculator::NewtonSeparated && !*cancelled) {
+      // For the chart; a summarized formula cannot be plotted.
+      result.nodes = calculator->get_nodes();
+      if (result.nodes.size() <= 2 * kLatexTerms) {
+        result.chart_latex = calculator->to_latex();
       }
     }
+    result.latex = calculator->to_latex(kLatexTerms);
+    // Without the flag, so that the section of a finished method still
+    // renders after a later cancel; the interpolant comes from node_set.
+    result.calculator =
+        std::make_shared<const IntepolationCalculator>(method, node_set);
+  } catch (const InterpolationCancelled &) {
+    // Discarded by start_run().
+  } catch (const std::exception &e) {
+    // Escaping the worker, it would be rethrown by result() on the GUI
+    // thread; shown in the section instead.
+    result.error = e.what();
+  }
+  return result;
+}
+
+void MainWindow::start_run(std::shared_ptr<const NodeSet> node_set,
+                           std::vector<double> queries,
+                           std::function<void()> finished) {
+  stop_run();
+  clear_results();
+  auto cancelled = std::make_shared<std::atomic<bool>>(false);
+  auto shared_queries =
+      std::make_shared<const std::vector<double>>(std::move(queries));
+  run_cancelled = cancelled;
+  run_finished = std::move(finished);
+  pending_methods = static_cast<int>(std::size(kMethods));
+  ui->cancel_btn->setEnabled(true);
+
+  for (auto method : kMethods) {
+    auto *watcher = new QFutureWatcher<MethodResult>(this);
+    // finished is delivered through the event loop, on the GUI thread.
+    connect(watcher, &QFutureWatcher<MethodResult>::finished, this,
+            [this, watcher, cancelled, shared_queries] {
+              watcher->deleteLater();
+              if (*cancelled) {
+                return;
+              }
+              show_result(watcher->result(), *shared_queries);
+              if (--pending_methods == 0) {
+                ui->cancel_btn->setEnabled(false);
+                run_cancelled.reset();
+                if (run_finished) {
+                  std::exchange(run_finished, nullptr)();
+                }
+                show_profile();
+              }
+            });
+    watcher->setFuture(QtConcurrent::run(
+        [method, node_set, shared_queries, cancelled] {
+          return compute_method(method, node_set, shared_queries, cancelled);
+        }));
+  }
+}
+
+bool MainWindow::stop_run() {
+  if (!run_cancelled) {
+    return false;
+  }
+  *run_cancelled = true;
+  run_cancelled.reset();
+  run_finished = nullptr;
+  pending_methods = 0;
+  ui->cancel_btn->setEnabled(false);
+  return true;
+}
 
-    if (method == IntepolationCalculator::NewtonSeparated) {
-      draw_chart(nodes, latex);
+void MainWindow::show_result(const MethodResult &result,
+                             const std::vector<double> &queries) {
+  INTERP_PROFILE_SCOPE("gui.append");
+  auto *page = new QWidget;
+  auto *view = new QTextBrowser;
+  auto *layout = new QVBoxLayout(page);
+  layout->setContentsMargins(0, 0, 0, 0);
+  layout->addWidget(view);
+  auto method_name = IntepolationCalculator::method_to_string(result.method);
+  if (!result.error.empty()) {
+    view->append("<b>Error: </b>" + QString::fromStdString(result.error));
+  } else if (result.values.size() == 1) {
+    view->append("<b>Interpolated value: </b>" +
+                 QString::number(result.values[0]));
+  } else {
+    const auto &values = result.values;
+    view->append("<b>Interpolated values: </b>");
+    std::size_t shown = std::min(values.size(), kShownQueries);
+    for (std::size_t i = 0; i < shown; i++) {
+      view->append("f(" + QString::number(queries[i]) + ") = " +
+                   QString::number(values[i]));
+    }
+    if (shown < values.size()) {
+      view->append(QString("... and %1 more").arg(values.size() - shown));
     }
+  }
+  sections.push_back({result, page, view, !result.error.empty()});
+  // Adding the first page makes it current, which renders it.
+  ui->results_box->addItem(page, QString::fromStdString(method_name));
+
+  if (result.method == IntepolationCalculator::NewtonSeparated &&
+      result.error.empty()) {
+    draw_chart(result.nodes, result.chart_latex);
+  }
+}
 
-    ui->textBrowser->append("");
+void MainWindow::render_section(int index) {
+  if (index < 0 || static_cast<std::size_t>(index) >= sections.size() ||
+      sections[index].rendered) {
+    return;
+  }
+  INTERP_PROFILE_SCOPE("gui.render");
+  ResultSection &section = sections[index];
+  section.rendered = true;
+  const IntepolationCalculator &calculator = *section.result.calculator;
+  QTextBrowser *view = section.view;
+  view->append("<b>Function: </b>" +
+               QString::fromStdString(section.result.latex));
+  // Nodes and differences go through a model, so only the visible cells
+  // are ever formatted.
+  bool differences = section.result.method != IntepolationCalculator::Lagrange;
+  view->append(differences ? "<b>Nodes and difference table: </b>"
+                           : "<b>Nodes: </b>");
+  auto *table = new QTableView;
+  table->setModel(new DifferenceTableModel(calculator.get_node_set(),
+                                           differences, table));
+  // Fixed sections: resizing to contents would format every cell.
+  table->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+  table->verticalHeader()->setDefaultSectionSize(
+      table->fontMetrics().height() + 4);
+  table->horizontalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+  section.page->layout()->addWidget(table);
+}
+
+void MainWindow::clear_results() {
+  sections.clear();
+  while (ui->results_box->count() > 0) {
+    QWidget *page = ui->results_box->widget(0);
+    ui->results_box->removeItem(0);
+    page->deleteLater();
   }
 }
 
@@ -263,6 +441,7 @@ void MainWindow::on_remove_btn_clicked() {
 void MainWindow::draw_chart(
     const std::vector<std::pair<double, double>> &points,
     std::string function) {
+  INTERP_PROFILE_SCOPE("gui.draw_chart");
   ui->webview->page()->runJavaScript("calculator.setBlank()");
   int i = 0;
   std::replace(function.begin(), function.end(), ',', '.');
@@ -274,7 +453,38 @@ void MainWindow::draw_chart(
     ui->webview->page()->runJavaScript(v);
   }
 
+  if (function.empty()) {
+    return;
+  }
   auto v = QString("calculator.setExpression({ id: 'graph', latex: '%1'})")
                .arg(function.c_str());
   ui->webview->page()->runJavaScript(v);
 }
+
+void MainWindow::show_profile() {
+#ifdef INTERP_PROFILING
+  ui->statusbar->showMessage(
+      QString::fromStdString(Profiler::instance().summary()));
+#endif
+}
+
+void MainWindow::export_profile(bool chrome_trace) {
+#ifdef INTERP_PROFILING
+  QString file_name = QFileDialog::getSaveFileName(
+      this, chrome_trace ? tr("Export Chrome trace") : tr("Export profile"), "",
+      tr("JSON files (*.json)"));
+  if (file_name.isEmpty()) {
+    return;
+  }
+  std::string contents = chrome_trace ? Profiler::instance().to_chrome_trace()
+                                      : Profiler::instance().to_json();
+  QFile file(file_name);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+      file.write(contents.data(), static_cast<qint64>(contents.size())) !=
+          static_cast<qint64>(contents.size())) {
+    ui->statusbar->showMessage("Failed to write " + file_name);
+  }
+#else
+  static_cast<void>(chrome_trace);
+#endif
+}